@@ -0,0 +1,220 @@
+#!/usr/bin/env python
+
+#
+# LSST Data Management System
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""Benchmark findCosmicRays on synthetic frames
+
+Frames of several sizes, sky levels and CR densities are generated with a Gaussian
+PSF, some stars, and CRs with a mixture of morphologies (single-pixel hits, short
+worms and long straight tracks).  For each frame findCosmicRays is timed end to end
+and per phase, and its completeness (the fraction of injected CRs that were found)
+and the number of spurious detections are reported.
+
+e.g.
+    crBenchmark.py --sizes 1024 2048 --skies 100 1000 --densities 100 1000 --nThreads 1 4
+"""
+import argparse
+import math
+import time
+
+import numpy as np
+
+import lsst.geom
+import lsst.afw.image as afwImage
+import lsst.meas.algorithms as measAlg
+import lsst.pex.config as pexConfig
+
+
+def addTrack(image, x0, y0, length, angle, dn, width, rng):
+    """Add a straight CR track to an image, returning the (y, x) coordinates of its pixels
+
+    The track starts at (x0, y0) and deposits about dn per pixel along its length,
+    with 20% pixel-to-pixel fluctuations; tracks with width > 1 spill half their
+    charge into the adjacent pixel on each side.
+    """
+    height, ncol = image.shape
+    nstep = max(1, int(2*length))
+    dx, dy = math.cos(angle), math.sin(angle)
+    pixels = set()
+    for i in range(nstep + 1):
+        t = length*i/nstep
+        pixels.add((int(round(x0 + t*dx)), int(round(y0 + t*dy))))
+
+    xs, ys = [], []
+    for x, y in sorted(pixels):
+        if 0 <= x < ncol and 0 <= y < height:
+            value = dn*rng.uniform(0.8, 1.2)
+            image[y, x] += value
+            xs.append(x)
+            ys.append(y)
+            if width > 1:
+                for ox, oy in ((-dy, dx), (dy, -dx)):
+                    xx, yy = int(round(x + ox)), int(round(y + oy))
+                    if 0 <= xx < ncol and 0 <= yy < height:
+                        image[yy, xx] += 0.5*value
+
+    return np.array(ys, dtype=int), np.array(xs, dtype=int)
+
+
+def makeFrame(size, sky, density, psf, rng, readNoise=5.0, nStar=50):
+    """Make a synthetic frame
+
+    Parameters
+    ----------
+    size : `int`
+        Width and height of the frame.
+    sky : `float`
+        Sky level (the frame is not background subtracted).
+    density : `float`
+        Number of CRs per million pixels.
+    psf : `lsst.afw.detection.Psf`
+        PSF used to add stars.
+    rng : `numpy.random.RandomState`
+        Random number generator.
+    readNoise : `float`
+        Read noise.
+    nStar : `int`
+        Number of stars to add.
+
+    Returns
+    -------
+    mi : `lsst.afw.image.MaskedImageF`
+        The frame.
+    tracks : `list` of `tuple` of `numpy.ndarray`
+        The (y, x) coordinates of the pixels of each CR that was added.
+    """
+    mi = afwImage.MaskedImageF(size, size)
+    variance = sky + readNoise**2
+    ima = mi.getImage().getArray()
+    ima[:] = sky + rng.normal(0.0, math.sqrt(variance), ima.shape)
+    mi.getVariance().set(variance)
+    #
+    # Stars, which the CR finder should leave alone
+    #
+    psfImage = psf.computeKernelImage(lsst.geom.Point2D(0, 0)).getArray()
+    ph, pw = psfImage.shape
+    for i in range(nStar):
+        x, y = rng.randint(0, size - pw), rng.randint(0, size - ph)
+        ima[y:y + ph, x:x + pw] += rng.uniform(1e3, 1e5)*psfImage
+    #
+    # Cosmic rays
+    #
+    nCr = rng.poisson(density*size*size/1e6)
+    tracks = []
+    for i in range(nCr):
+        x0, y0 = rng.uniform(0, size), rng.uniform(0, size)
+        kind = rng.uniform()
+        if kind < 0.4:                  # single-pixel hit
+            track = addTrack(ima, x0, y0, 0, 0.0, rng.uniform(10, 100)*math.sqrt(variance), 1, rng)
+        elif kind < 0.8:                # short worm
+            track = addTrack(ima, x0, y0, rng.uniform(2, 8), rng.uniform(0, 2*math.pi),
+                             rng.uniform(10, 50)*math.sqrt(variance), 1, rng)
+        else:                           # long, grazing, track
+            track = addTrack(ima, x0, y0, rng.uniform(10, 60), rng.uniform(0, 2*math.pi),
+                             rng.uniform(10, 30)*math.sqrt(variance), 2, rng)
+        if len(track[0]) > 0:
+            tracks.append(track)
+
+    return mi, tracks
+
+
+def measureCompleteness(crs, tracks, shape):
+    """Return the number of injected CRs that were found, and the number of detections
+    that don't correspond to an injected CR"""
+    found = np.zeros(shape, dtype=bool)
+    for cr in crs:
+        for span in cr.getSpans():
+            found[span.getY(), span.getX0():span.getX1() + 1] = True
+
+    nFound = sum(1 for ys, xs in tracks if found[ys, xs].any())
+
+    allTracks = np.zeros(shape, dtype=bool)
+    for ys, xs in tracks:
+        allTracks[ys, xs] = True
+    nSpurious = 0
+    for cr in crs:
+        if not any(allTracks[span.getY(), span.getX0():span.getX1() + 1].any() for span in cr.getSpans()):
+            nSpurious += 1
+
+    return nFound, nSpurious
+
+
+def run(sizes, skies, densities, nThreadsList, nRepeat, seed, fwhm):
+    sigma = fwhm/(2*math.sqrt(2*math.log(2)))
+    psfSize = 2*int(4*sigma) + 1
+    psf = measAlg.SingleGaussianPsf(psfSize, psfSize, sigma)
+
+    print("%6s %7s %7s %3s %8s %9s %7s %7s %7s %7s %7s %5s %5s %6s %5s" %
+          ("size", "sky", "density", "nT", "time(s)", "Mpix/s", "detect", "merge", "filter", "remove",
+           "grow", "nCR", "found", "compl", "spur"))
+
+    rng = np.random.RandomState(seed)
+    for size in sizes:
+        for sky in skies:
+            for density in densities:
+                mi0, tracks = makeFrame(size, sky, density, psf, rng)
+                for nThreads in nThreadsList:
+                    config = measAlg.FindCosmicRaysConfig()
+                    config.nThreads = nThreads
+                    policy = pexConfig.makePolicy(config)
+
+                    best = None
+                    for i in range(nRepeat):
+                        mi = afwImage.MaskedImageF(mi0, True)
+                        stats = measAlg.CosmicRayStatistics()
+                        t0 = time.time()
+                        crs = measAlg.findCosmicRays(mi, psf, sky, policy, stats=stats)
+                        elapsed = time.time() - t0
+                        if best is None or elapsed < best[0]:
+                            best = (elapsed, stats, crs)
+
+                    elapsed, stats, crs = best
+                    nFound, nSpurious = measureCompleteness(crs, tracks, mi0.getImage().getArray().shape)
+                    print("%6d %7.0f %7.0f %3d %8.3f %9.2f %7.3f %7.3f %7.3f %7.3f %7.3f %5d %5d %6.3f %5d" %
+                          (size, sky, density, nThreads, elapsed, size*size/elapsed/1e6,
+                           stats.detectTime, stats.mergeTime, stats.filterTime, stats.removeTime,
+                           stats.growTime, len(tracks), nFound,
+                           nFound/len(tracks) if tracks else float("nan"), nSpurious))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--sizes", type=int, nargs="+", default=[512, 2048, 4096],
+                        help="width (and height) of frames")
+    parser.add_argument("--skies", type=float, nargs="+", default=[100.0, 1000.0],
+                        help="sky levels")
+    parser.add_argument("--densities", type=float, nargs="+", default=[50.0, 500.0],
+                        help="number of CRs per million pixels")
+    parser.add_argument("--nThreads", type=int, nargs="+", default=[1],
+                        help="values of FindCosmicRaysConfig.nThreads to try")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="number of times to time each frame (the fastest is reported)")
+    parser.add_argument("--seed", type=int, default=1, help="random number seed")
+    parser.add_argument("--fwhm", type=float, default=3.0, help="FWHM of PSF (pixels)")
+    args = parser.parse_args()
+
+    run(args.sizes, args.skies, args.densities, args.nThreads, args.repeat, args.seed, args.fwhm)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,247 @@
+#!/usr/bin/env python
+
+#
+# LSST Data Management System
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""Benchmark interpolateOverDefects on synthetic frames, and check its outputs
+
+Frames of several sizes are generated with defect maps of several densities, made up of
+defects of one class (middle, near-edge, edge, wide, or bad columns) or a mixture of all
+of them.  For each frame the reference code (interpolateOverDefects) is timed, along with
+the faster ways of doing the same thing (a prebuilt DefectPlan, several threads, and
+applying a plan to a batch of images).  Each of the latter must reproduce the reference
+image, mask and variance bit for bit; any that don't are reported, and the exit status is
+non-zero.
+
+The checksums of the reference outputs may also be written to a file with --golden FILE
+--update, and later runs with --golden FILE will check that they haven't changed.  This
+guards changes to the reference code itself.  Only compare checksums made on the same
+platform, as the compiler may legitimately change the rounding of the interpolants.
+
+e.g.
+    interpBenchmark.py --sizes 1024 4096 --densities 100 1000 --nThreads 4
+"""
+import argparse
+import hashlib
+import json
+import sys
+import time
+
+import numpy as np
+
+import lsst.geom
+import lsst.afw.image as afwImage
+import lsst.meas.algorithms as measAlg
+
+defectClasses = ["middle", "nearEdge", "edge", "wide", "column", "mixed"]
+
+
+def makeDefects(bbox, defectClass, density, rng):
+    """Make a list of defects of a given class
+
+    Parameters
+    ----------
+    bbox : `lsst.geom.Box2I`
+        Bounding box of the frame.
+    defectClass : `str`
+        Type of defects; one of defectClasses.
+    density : `float`
+        Number of defects per million pixels.
+    rng : `numpy.random.RandomState`
+        Random number generator.
+
+    Returns
+    -------
+    defects : `list` of `lsst.meas.algorithms.Defect`
+        The defects.
+    """
+    width, height = bbox.getWidth(), bbox.getHeight()
+    nDefect = max(1, int(density*width*height/1e6))
+
+    defects = []
+    for i in range(nDefect):
+        cls = rng.choice(defectClasses[:-1]) if defectClass == "mixed" else defectClass
+        if cls == "middle":             # short runs, well away from the edges
+            dx, dy = rng.randint(1, 6), rng.randint(1, 4)
+            x0 = rng.randint(2, width - dx - 2)
+        elif cls == "nearEdge":         # within a pixel of the left or right edge
+            dx, dy = rng.randint(1, 6), rng.randint(1, 4)
+            x0 = 1 if rng.uniform() < 0.5 else width - dx - 1
+        elif cls == "edge":             # touching the left or right edge
+            dx, dy = rng.randint(1, 16), rng.randint(1, 4)
+            x0 = 0 if rng.uniform() < 0.5 else width - dx
+        elif cls == "wide":             # at least Defect.WIDE_DEFECT pixels wide
+            dx, dy = rng.randint(11, 40), rng.randint(1, 4)
+            x0 = rng.randint(2, width - dx - 2)
+        elif cls == "column":           # bad columns and bleed trails
+            dx, dy = rng.randint(1, 4), rng.randint(height//10, height//2)
+            x0 = rng.randint(2, width - dx - 2)
+        else:
+            raise ValueError("Unknown class of defect: %s" % cls)
+        y0 = rng.randint(0, height - dy)
+
+        defects.append(measAlg.Defect(lsst.geom.BoxI(bbox.getMin() + lsst.geom.ExtentI(x0, y0),
+                                                     lsst.geom.ExtentI(dx, dy))))
+
+    return defects
+
+
+def makeFrame(size, rng, sky=1000.0):
+    """Make a synthetic frame of noise on a sky level"""
+    mi = afwImage.MaskedImageF(lsst.geom.BoxI(lsst.geom.PointI(10, 20), lsst.geom.ExtentI(size, size)))
+    mi.image.array[:] = sky + rng.normal(0.0, np.sqrt(sky), mi.image.array.shape)
+    mi.variance.array[:] = sky
+    return mi
+
+
+def checksums(mi):
+    """Return the checksums of the image, mask and variance of mi"""
+    return tuple(hashlib.sha1(np.ascontiguousarray(plane.array).tobytes()).hexdigest()[:12]
+                 for plane in (mi.image, mi.mask, mi.variance))
+
+
+def timeIt(func, mi0, nRepeat):
+    """Run func on copies of mi0 nRepeat times, returning the fastest time and the last output"""
+    best = None
+    for i in range(nRepeat):
+        mi = afwImage.MaskedImageF(mi0, True)
+        t0 = time.time()
+        func(mi)
+        elapsed = time.time() - t0
+        if best is None or elapsed < best:
+            best = elapsed
+    return best, mi
+
+
+def run(sizes, classes, densities, nThreads, nBatch, nRepeat, seed, golden, update):
+    psf = measAlg.DoubleGaussianPsf(15, 15, 1.0)
+    fallbackValue = 0.0
+
+    goldenChecksums = {}
+    if golden and not update:
+        with open(golden) as fd:
+            goldenChecksums = json.load(fd)
+    newChecksums = {}
+    nFailed = 0
+
+    print("%6s %8s %7s %7s %9s %9s %9s %9s %9s %-38s %s" %
+          ("size", "class", "density", "nPixel", "ref(s)", "build(s)", "plan(s)", "thread(s)",
+           "batch(s)", "checksums (image mask variance)", "status"))
+
+    for size in sizes:
+        mi0 = makeFrame(size, np.random.RandomState([seed, size]))
+        for defectClass in classes:
+            for density in densities:
+                # seed each defect map separately, so that the golden checksums don't depend on which
+                # frames we chose to process
+                key = "%d-%s-%g-%d" % (size, defectClass, density, seed)
+                rng = np.random.RandomState([seed, size, defectClasses.index(defectClass), int(density)])
+                defects = makeDefects(mi0.getBBox(), defectClass, density, rng)
+                #
+                # The reference implementation
+                #
+                tRef, reference = timeIt(lambda mi: measAlg.interpolateOverDefects(mi, psf, defects,
+                                                                                   fallbackValue, True),
+                                         mi0, nRepeat)
+                expected = checksums(reference)
+                newChecksums[key] = expected
+                #
+                # Faster ways of doing the same thing, which must match bit for bit
+                #
+                t0 = time.time()
+                plan = measAlg.DefectPlan(defects, mi0.getBBox())
+                tBuild = time.time() - t0
+
+                def applyPlan(mi, nThreads=1):
+                    return plan.apply(mi, fallbackValue, True, nThreads)
+
+                tPlan, mi = timeIt(applyPlan, mi0, nRepeat)
+                failures = ["plan"] if checksums(mi) != expected else []
+                nPixel = applyPlan(afwImage.MaskedImageF(mi0, True)).nPixel
+
+                tThread, mi = timeIt(lambda mi: applyPlan(mi, nThreads=nThreads), mi0, nRepeat)
+                if checksums(mi) != expected:
+                    failures.append("threads")
+
+                tBatch = None
+                for i in range(nRepeat):
+                    images = [afwImage.MaskedImageF(mi0, True) for j in range(nBatch)]
+                    t0 = time.time()
+                    plan.applyBatch(images, fallbackValue, True, nThreads)
+                    elapsed = (time.time() - t0)/nBatch
+                    if tBatch is None or elapsed < tBatch:
+                        tBatch = elapsed
+                if any(checksums(mi) != expected for mi in images):
+                    failures.append("batch")
+                #
+                # Has the reference implementation changed?
+                #
+                if key in goldenChecksums and tuple(goldenChecksums[key]) != expected:
+                    failures.append("golden")
+
+                nFailed += 1 if failures else 0
+                print("%6d %8s %7g %7d %9.4f %9.4f %9.4f %9.4f %9.4f %-38s %s" %
+                      (size, defectClass, density, nPixel, tRef, tBuild, tPlan, tThread, tBatch,
+                       " ".join(expected), ("FAILED: " + ", ".join(failures)) if failures else "OK"))
+
+    if golden and update:
+        with open(golden, "w") as fd:
+            json.dump(newChecksums, fd, indent=2, sort_keys=True)
+    elif golden:
+        missing = sorted(set(newChecksums) - set(goldenChecksums))
+        if missing:
+            print("No golden checksums for %s" % (", ".join(missing)))
+
+    return nFailed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--sizes", type=int, nargs="+", default=[512, 2048],
+                        help="width (and height) of frames")
+    parser.add_argument("--classes", nargs="+", default=defectClasses, choices=defectClasses,
+                        help="classes of defects")
+    parser.add_argument("--densities", type=float, nargs="+", default=[100.0, 1000.0, 10000.0],
+                        help="number of defects per million pixels")
+    parser.add_argument("--nThreads", type=int, default=4,
+                        help="number of threads for the threaded and batch tests")
+    parser.add_argument("--nBatch", type=int, default=4, help="number of images in a batch")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="number of times to time each frame (the fastest is reported)")
+    parser.add_argument("--seed", type=int, default=1, help="random number seed")
+    parser.add_argument("--golden", help="file of golden checksums of the reference outputs")
+    parser.add_argument("--update", action="store_true", default=False,
+                        help="write the reference checksums to --golden rather than checking them")
+    args = parser.parse_args()
+
+    if args.update and not args.golden:
+        parser.error("--update requires --golden")
+
+    nFailed = run(args.sizes, args.classes, args.densities, args.nThreads, args.nBatch, args.repeat,
+                  args.seed, args.golden, args.update)
+    if nFailed:
+        print("%d frame%s failed" % (nFailed, "" if nFailed == 1 else "s"))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -27,6 +27,8 @@
 //!
 // Handle cosmic rays in a MaskedImage
 //
+#include <functional>
+#include <memory>
 #include <vector>
 #include "lsst/base.h"
 #include "lsst/pex/policy.h"
@@ -45,12 +47,130 @@ namespace lsst {
 namespace meas {
 namespace algorithms {
 
+/**
+ * Timings and counts for the phases of findCosmicRays
+ *
+ * Times are wall-clock seconds.
+ */
+struct CosmicRayStatistics {
+    CosmicRayStatistics() = default;
+
+    double detectTime = 0.0;  ///< time spent searching the image for contaminated pixels
+    double mergeTime = 0.0;   ///< time spent merging the pixels into spans and CRs
+    double filterTime = 0.0;  ///< time spent applying the min_DN cut
+    double removeTime = 0.0;  ///< time spent replacing the CRs' pixels (both passes)
+    double growTime = 0.0;    ///< time spent looking for contaminated pixels next to the CRs
+    double totalTime = 0.0;   ///< total time spent in findCosmicRays
+
+    long nCandidate = 0;       ///< pixels given the full is_cr_pixel test; one re-tested after its
+                               ///< neighbour was corrected is counted each time
+    long nPixel = 0;           ///< pixels flagged as contaminated by the search
+    long nSpan = 0;            ///< spans of contaminated pixels
+    int nCrInitial = 0;        ///< CRs before the min_DN cut
+    int nCr = 0;               ///< CRs after the min_DN cut
+    std::vector<long> nGrow;   ///< pixels added to the CRs in each growth iteration
+};
+
+/**
+ * Find cosmic rays in an Image, and mask and remove them
+ *
+ * @param image   Image to search
+ * @param psf     The Image's PSF
+ * @param bkgd    Unsubtracted background of frame, DN
+ * @param policy  Policy directing the behavior
+ * @param keep    If true, don't remove the CRs
+ * @param stats   If not null, set to the timings and counts for each phase of the search
+ *
+ * @return vector of CR's Footprints
+ */
 template <typename MaskedImageT>
 std::vector<std::shared_ptr<afw::detection::Footprint> > findCosmicRays(MaskedImageT& image,
                                                                         afw::detection::Psf const& psf,
                                                                         double const bkgd,
                                                                         pex::policy::Policy const& policy,
-                                                                        bool const keep = false);
+                                                                        bool const keep = false,
+                                                                        CosmicRayStatistics* stats = nullptr);
+
+/**
+ * Find cosmic rays in many images, e.g. all the CCDs of a visit, and mask and remove them
+ *
+ * This is equivalent to calling findCosmicRays for each image, but the policy is only parsed once,
+ * the thresholds derived from each distinct Psf (i.e. Psf object) are only calculated once, and the images
+ * are processed in parallel.  When more than one image is processed at a time, each image is searched
+ * with a single thread.
+ *
+ * If findCosmicRays throws for any image the other images are still processed, and the exception from
+ * the first such image is rethrown.
+ *
+ * @param images    Images to search
+ * @param psfs      PSF of each image
+ * @param bkgds     Unsubtracted background level of each image
+ * @param policy    Policy with the parameters used by findCosmicRays
+ * @param nThreads  Number of images to process at once; <= 0 means one per core
+ * @param keep      If true, don't remove the CRs
+ *
+ * @return the CRs found in each image
+ */
+template <typename MaskedImageT>
+std::vector<std::vector<std::shared_ptr<afw::detection::Footprint> > > findCosmicRaysBatch(
+        std::vector<std::shared_ptr<MaskedImageT> > const& images,
+        std::vector<std::shared_ptr<afw::detection::Psf const> > const& psfs,
+        std::vector<double> const& bkgds, pex::policy::Policy const& policy, int const nThreads = 0,
+        bool const keep = false);
+
+/**
+ * Find cosmic rays in an image that's too large to process at once, one tile at a time
+ *
+ * The image is divided into tiles of at most tileWidth x tileHeight pixels; each is read, grown by
+ * overlap pixels on every side (but not beyond bbox), with readTile, searched with findCosmicRays, and
+ * the part of the tile that it owns (i.e. without the overlap) is handed back to writeTile.  The nCrPixelMax
+ * limit in the policy applies to each tile separately.
+ *
+ * Every tile must be searched in the original pixels, so a tile isn't handed to writeTile until all the
+ * tiles whose overlap reaches into it have been read; the tiles are processed a row at a time, so about
+ * a row of tiles (plus one) is held in memory.  readTile must return the original pixels, not any that
+ * have already been passed to writeTile.
+ *
+ * Each tile keeps the parts of the CRs that lie in the region it owns, and pieces that touch across the
+ * edges of tiles are then merged, so the returned Footprints are in the image's parent coordinates and
+ * are sorted by their first pixel (row, then column).
+ *
+ * The results are the same as running findCosmicRays on the whole image as long as every CR (after it's
+ * been grown) is no closer than overlap - 2 pixels to the outside of the tile it's found in; that is,
+ * overlap should be comfortably larger than the largest CR expected.
+ *
+ * @param bbox        Bounding box of the whole image, in parent coordinates
+ * @param readTile    Return a (writeable) MaskedImage of the original pixels in the given parent
+ *                    bounding box; its mask must have the BAD, CR, INTRP, SAT and NO_DATA planes
+ * @param writeTile   Store the processed pixels in the given parent bounding box (the image passed
+ *                    may be larger than that box)
+ * @param psf         PSF of the image
+ * @param bkgd        Unsubtracted background level
+ * @param policy      Policy with the parameters used by findCosmicRays
+ * @param tileWidth   Width of a tile, excluding overlap
+ * @param tileHeight  Height of a tile, excluding overlap
+ * @param overlap     Number of pixels added around each tile
+ * @param keep        If true, don't remove the CRs
+ */
+template <typename MaskedImageT>
+std::vector<std::shared_ptr<afw::detection::Footprint> > findCosmicRaysTiled(
+        lsst::geom::Box2I const& bbox,
+        std::function<std::shared_ptr<MaskedImageT>(lsst::geom::Box2I const&)> const& readTile,
+        std::function<void(MaskedImageT const&, lsst::geom::Box2I const&)> const& writeTile,
+        afw::detection::Psf const& psf, double const bkgd, pex::policy::Policy const& policy,
+        int const tileWidth, int const tileHeight, int const overlap = 32, bool const keep = false);
+
+/**
+ * Find cosmic rays in an in-memory image, processing it in tiles
+ *
+ * This is findCosmicRaysTiled with tiles that are copies of parts of image, and are written back to it;
+ * its only use is to bound the temporary memory used to hold the detected pixels.
+ */
+template <typename MaskedImageT>
+std::vector<std::shared_ptr<afw::detection::Footprint> > findCosmicRaysTiled(
+        MaskedImageT& image, afw::detection::Psf const& psf, double const bkgd,
+        pex::policy::Policy const& policy, int const tileWidth, int const tileHeight, int const overlap = 32,
+        bool const keep = false);
 }
 }  // namespace meas
 }  // namespace lsst
@@ -24,7 +24,10 @@
 #if !defined(LSST_MEAS_ALGORITHMS_COADDPSF_H)
 #define LSST_MEAS_ALGORITHMS_COADDPSF_H
 
+#include <cstddef>
 #include <memory>
+#include <vector>
+#include "ndarray.h"
 #include "lsst/base.h"
 #include "lsst/pex/config.h"
 #include "lsst/meas/algorithms/ImagePsf.h"
@@ -44,11 +47,50 @@ public:
     LSST_CONTROL_FIELD(warpingKernelName, std::string,
                        "Name of warping kernel; choices: lanczos3,lanczos4,lanczos5,bilinear,nearest");
     LSST_CONTROL_FIELD(cacheSize, int, "Warping kernel cache size");
+    LSST_CONTROL_FIELD(kernelCacheCellSize, double,
+                       "Size (coadd pixels) of the kernel image cache's cells; all positions in a cell "
+                       "with the same inputs share the kernel image at the cell's centre");
+    LSST_CONTROL_FIELD(kernelCacheMaxMemory, double,
+                       "Maximum memory (MB) used by the kernel image cache; <= 0 disables the cache");
+    LSST_CONTROL_FIELD(nThreads, int,
+                       "Number of threads used to warp the inputs' kernel images; <= 0 means as many "
+                       "as the hardware supports.  The results don't depend on nThreads");
 
-    explicit CoaddPsfControl(std::string _warpingKernelName = "lanczos3", int _cacheSize = 10000)
-            : warpingKernelName(_warpingKernelName), cacheSize(_cacheSize) {}
+    explicit CoaddPsfControl(std::string _warpingKernelName = "lanczos3", int _cacheSize = 10000,
+                             double _kernelCacheCellSize = 1.0, double _kernelCacheMaxMemory = 0.0,
+                             int _nThreads = 1)
+            : warpingKernelName(_warpingKernelName),
+              cacheSize(_cacheSize),
+              kernelCacheCellSize(_kernelCacheCellSize),
+              kernelCacheMaxMemory(_kernelCacheMaxMemory),
+              nThreads(_nThreads) {}
 };
 
+/**
+ * @brief Statistics about the use of a CoaddPsf's kernel image cache
+ */
+struct CoaddPsfCacheStatistics {
+    CoaddPsfCacheStatistics() = default;
+
+    long nHit = 0;           ///< kernel images that were found in the cache
+    long nMiss = 0;          ///< kernel images that had to be computed (and were added to the cache)
+    long nEvicted = 0;       ///< kernel images dropped from the cache to keep within its memory limit
+    std::size_t nEntry = 0;  ///< kernel images in the cache
+    std::size_t memory = 0;  ///< memory used by the cached images (bytes)
+};
+
+/// Kernel images at many positions, padded to a common bounding box; see CoaddPsf::computeKernelImages
+struct CoaddPsfKernelImageStack {
+    CoaddPsfKernelImageStack() = default;
+
+    ndarray::Array<double, 3, 3> images;  ///< images, indexed as [position, y - bbox.minY, x - bbox.minX]
+    geom::Box2I bbox;                     ///< bounding box of each image, in kernel-image coordinates
+};
+
+namespace detail {
+class ThreadPool;
+}  // namespace detail
+
 /**
  *  @brief CoaddPsf is the Psf derived to be used for non-PSF-matched Coadd images.
  *
@@ -92,7 +134,10 @@ public:
      */
     CoaddPsf(afw::table::ExposureCatalog const& catalog, afw::geom::SkyWcs const& coaddWcs,
              CoaddPsfControl const& ctrl, std::string const& weightFieldName = "weight")
-            : CoaddPsf(catalog, coaddWcs, weightFieldName, ctrl.warpingKernelName, ctrl.cacheSize) {}
+            : CoaddPsf(catalog, coaddWcs, weightFieldName, ctrl.warpingKernelName, ctrl.cacheSize) {
+        setKernelImageCache(ctrl.kernelCacheCellSize, ctrl.kernelCacheMaxMemory);
+        setNumThreads(ctrl.nThreads);
+    }
 
     /// Polymorphic deep copy.  Usually unnecessary, as Psfs are immutable.
     PTR(afw::detection::Psf) clone() const override;
@@ -167,6 +212,65 @@ public:
      */
     CONST_PTR(afw::geom::polygon::Polygon) getValidPolygon(int index);
 
+    /**
+     * @brief Cache kernel images, and reuse them at nearby positions
+     *
+     * The coadd is divided into square cells, and the first time a kernel image is needed anywhere
+     * in a cell it's computed at the cell's centre (using the inputs that contain the requested
+     * position) and cached.  Later requests in the same cell with the same inputs return a copy of
+     * the cached image, so the PSF is quantised to the cells.  The least recently used images are
+     * dropped to keep the cache within its memory limit.  Images with a known color aren't cached.
+     *
+     * This cache is independent of the afw::detection::Psf cache, which sits in front of it:  repeated
+     * requests at exactly the same position are answered by the latter, and never reach this one.  As
+     * the results at a position may change, the cache should be configured before computing any images.
+     * It isn't persisted.
+     *
+     * @param[in] cellSize   Size of the cells, in coadd pixels
+     * @param[in] maxMemory  Maximum memory used by the cached images (MB); if <= 0, don't cache
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if maxMemory > 0 and cellSize <= 0
+     */
+    void setKernelImageCache(double cellSize, double maxMemory);
+
+    /// Return statistics about the use of the kernel image cache (all zero if there is no cache)
+    CoaddPsfCacheStatistics getKernelImageCacheStatistics() const;
+
+    /**
+     * @brief Compute the kernel images at many positions at once
+     *
+     * This returns the same images as computeKernelImage(position, color, INTERNAL) at each position,
+     * but finds the inputs at all the positions first, and makes each input's WarpedPsf once for all
+     * the positions with the same inputs rather than once per position.  If the kernel image cache is
+     * in use (see setKernelImageCache) the images come from the cache, one position at a time.  The
+     * images are zero-padded to the union of their bounding boxes and returned as a single contiguous
+     * array, which is cheaper than many calls from Python.
+     *
+     * @param[in] positions  Positions in the coadd's pixel coordinates
+     * @param[in] color      Color of the source
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if there are no inputs at any position
+     */
+    CoaddPsfKernelImageStack computeKernelImages(std::vector<geom::Point2D> const& positions,
+                                                 afw::image::Color const& color = afw::image::Color()) const;
+
+    /**
+     * @brief Set the number of threads used to warp the inputs' kernel images
+     *
+     * The inputs' images are warped in parallel, but always summed in catalog order, so the results
+     * don't depend on the number of threads.  If any Psf object is shared by several inputs, the
+     * images are warped one at a time, as Psfs aren't safe to use in several threads at once.  The
+     * threads are started here and kept until the number changes; clones share them, and if they're
+     * busy (e.g. computing another image for a clone in another thread) the images are warped in the
+     * calling thread.  The number of threads isn't persisted.
+     *
+     * @param[in] nThreads  Number of threads; <= 0 means as many as the hardware supports
+     */
+    void setNumThreads(int nThreads);
+
+    /// Return the number of threads used to warp the inputs' kernel images
+    int getNumThreads() const { return _nThreads; }
+
     /**
      *  @brief Return true if the CoaddPsf persistable (always true).
      *
@@ -205,12 +309,49 @@ protected:
     );
 
 private:
+    // The inputs' transforms to the coadd, built as needed; defined only in the source file
+    class ComponentCache;
+
+    // Spatial index of the inputs on the coadd; defined only in the source file
+    class InputIndex;
+
+    // Return the indices of the inputs that contain a point in the coadd, in catalog order
+    std::vector<std::size_t> _getInputsContaining(geom::Point2D const& ccdXY) const;
+
+    // Cache of kernel images; defined only in the source file
+    class KernelImageCache;
+
+    // WarpingControls for threads to use one at a time; defined only in the source file
+    class WarpingControlPool;
+
+    // Return the kernel image at a point in the coadd using the given inputs, via the cache if enabled
+    PTR(afw::detection::Psf::Image)
+    _getKernelImage(geom::Point2D const& ccdXY, afw::image::Color const& color,
+                    std::vector<std::size_t> const& inputs) const;
+
+    // Compute the kernel image at a point in the coadd, using the given inputs
+    PTR(afw::detection::Psf::Image)
+    _computeKernelImage(geom::Point2D const& ccdXY, afw::image::Color const& color,
+                        std::vector<std::size_t> const& inputs) const;
+
+    // Compute the kernel images at several points in the coadd, all using the given inputs
+    std::vector<PTR(afw::detection::Psf::Image)> _computeKernelImages(
+            std::vector<geom::Point2D> const& positions, afw::image::Color const& color,
+            std::vector<std::size_t> const& inputs) const;
+
     afw::table::ExposureCatalog _catalog;
     afw::geom::SkyWcs _coaddWcs;
     afw::table::Key<double> _weightKey;
     geom::Point2D _averagePosition;
     std::string _warpingKernelName;  // could be removed if we could get this from _warpingControl (#2949)
     CONST_PTR(afw::math::WarpingControl) _warpingControl;
+    std::shared_ptr<ComponentCache> _components;    // thread-safe, so may be shared by clones
+    std::shared_ptr<InputIndex const> _inputIndex;  // immutable, so may be shared by clones
+    std::shared_ptr<KernelImageCache> _kernelImageCache;  // null if disabled; not shared by clones
+    int _nThreads = 1;              // number of threads used to warp the inputs' kernel images
+    bool _inputsSharePsfs = false;  // do any inputs share a Psf?  Only set if _nThreads != 1
+    std::shared_ptr<WarpingControlPool> _warpingControlPool;  // only set if _nThreads != 1
+    std::shared_ptr<detail::ThreadPool> _threadPool;          // only set if _nThreads != 1
 };
 
 }  // namespace algorithms
@@ -27,12 +27,18 @@
 //!
 // Interpolate over defects in a MaskedImage
 //
+#include <cstddef>
 #include <limits>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "lsst/geom/Box.h"
+#include "lsst/afw/fits.h"
 #include "lsst/afw/image/Defect.h"
 #include "lsst/afw/image/MaskedImage.h"
+#include "lsst/afw/table/io/Persistable.h"
 
 namespace lsst {
 namespace afw {
@@ -62,8 +68,14 @@ double const lpc_1s2_c2 = -0.2358;
 double const min2GaussianBias = -0.5641895835;  ///< Mean value of the minimum of two N(0,1) variates
 
 template <typename MaskedImageT>
-std::pair<bool, typename MaskedImageT::Image::Pixel> singlePixel(int x, int y, MaskedImageT const &image,
-                                                                 bool horizontal, double minval);
+std::pair<bool, typename MaskedImageT::Image::Pixel> singlePixel(
+        int x, int y, MaskedImageT const &image, bool horizontal, double minval,
+        typename MaskedImageT::Mask::Pixel badMask = 0);
+
+template <typename MaskedImageT>
+std::vector<std::pair<bool, typename MaskedImageT::Image::Pixel>> singlePixels(
+        std::vector<geom::Point2I> const &positions, MaskedImageT const &image, bool horizontal,
+        double minval, typename MaskedImageT::Mask::Pixel badMask = 0);
 }  // namespace interp
 
 /**
@@ -107,10 +119,221 @@ private:
     unsigned int _type;   //!< Type of defect
 };
 
+/**
+ * @brief A run of bad pixels [x0, x1] in a single row, classified for interpolation
+ *
+ * Runs that a DefectPlan interpolates along a column use the same structure, with x0 and x1 the
+ * first and last bad rows.  See Defect for the meaning of pos and type
+ */
+struct DefectRun {
+    int x0;                      //!< first bad column
+    int x1;                      //!< last bad column
+    Defect::DefectPosition pos;  //!< position of the run relative to the edges of the row
+    unsigned int type;           //!< pattern of good and bad pixels used to choose the interpolant
+};
+
+/**
+ * @brief Statistics about the interpolation of a single image by a DefectPlan
+ */
+struct DefectInterpolationStatistics {
+    DefectInterpolationStatistics() = default;
+
+    long nPixel = 0;      ///< pixels interpolated over (including those set to the fallback value)
+    long nFallback = 0;   ///< pixels set to the fallback value as there was no usable data
+    long nNonFinite = 0;  ///< interpolated pixels whose new value isn't finite (e.g. NaN neighbours)
+};
+
+/**
+ * @brief A precomputed plan for interpolating over a set of Defects
+ *
+ * Building a plan does all the work of interpolateOverDefects that depends only on the defects and
+ * the images' bounding box (clipping, merging touching defects into runs in each row, and classifying
+ * the runs), so a plan may be built once per detector and applied to many images.
+ *
+ * Long vertical defects such as bad columns and bleed trails are poorly served by interpolating
+ * along rows, as each row sees a short run with nothing but the pixels either side to go on.  A plan
+ * may therefore interpolate the columns touched by tall defects along the column instead:  all the
+ * bad pixels in such a column (whichever defect they belong to) are interpolated vertically, and then
+ * the remaining bad pixels are interpolated along their rows, treating the repaired columns as good.
+ */
+class DefectPlan : public afw::table::io::PersistableFacade<DefectPlan>, public afw::table::io::Persistable {
+public:
+    /**
+     * @param[in] badList  Defects to interpolate over, in the same (parent) coordinates as bbox
+     * @param[in] bbox     Bounding box of the images that the plan will be applied to
+     * @param[in] columnAspectRatio  Interpolate along the columns touched by any defect whose height
+     *                               is at least columnAspectRatio times its width (after clipping to
+     *                               bbox); if <= 0, interpolate everything along rows
+     */
+    DefectPlan(std::vector<Defect::Ptr> const &badList, geom::Box2I const &bbox,
+               double columnAspectRatio = 0.0);
+
+    /**
+     * @brief Make a plan to interpolate over the pixels of a mask with any of the bits in bitmask set
+     *
+     * The runs of bad pixels are read directly from the mask, without creating any Defects.  The plan
+     * may be applied to any image with the mask's bounding box.
+     *
+     * @param[in] mask     Mask identifying the pixels to interpolate over
+     * @param[in] bitmask  Bits identifying the pixels to interpolate over
+     * @param[in] columnAspectRatio  As for the constructor from a list of Defects, where the "defects"
+     *                               are the rectangles formed by identical runs of bad pixels in
+     *                               consecutive rows
+     */
+    DefectPlan(afw::image::Mask<afw::image::MaskPixel> const &mask, afw::image::MaskPixel bitmask,
+               double columnAspectRatio = 0.0);
+
+    DefectPlan(DefectPlan const &) = default;
+    DefectPlan(DefectPlan &&) = default;
+    DefectPlan &operator=(DefectPlan const &) = default;
+    DefectPlan &operator=(DefectPlan &&) = default;
+    ~DefectPlan() override = default;
+
+    /**
+     * @brief Interpolate over the plan's defects, as interpolateOverDefects
+     *
+     * @param[in,out] image  Image to patch; its bounding box must be the plan's
+     * @param[in] fallbackValue  Value to fallback to if all else fails
+     * @param[in] useFallbackValueAtEdge  Use the fallback value at the image's edge?
+     * @param[in] nThreads  Number of threads to split the rows between; <= 0 means as many as the
+     *                      hardware supports.  The result doesn't depend on nThreads.
+     *
+     * @returns statistics about the interpolation
+     *
+     * @throws lsst::pex::exceptions::LengthError if image's bounding box differs from getBBox()
+     */
+    template <typename MaskedImageT>
+    DefectInterpolationStatistics apply(MaskedImageT &image, double fallbackValue = 0.0,
+                                        bool useFallbackValueAtEdge = false, int nThreads = 1) const;
+
+    /**
+     * @brief Interpolate over the plan's defects in a set of images, as apply
+     *
+     * This is equivalent to calling apply on each image in turn, but each row's runs are only
+     * read once and applied to all the images before moving on to the next row.
+     *
+     * @param[in,out] images  Images to patch; their bounding boxes must be the plan's
+     * @param[in] fallbackValue  Value to fallback to if all else fails
+     * @param[in] useFallbackValueAtEdge  Use the fallback value at the image's edge?
+     * @param[in] nThreads  Number of threads to split the rows between; <= 0 means as many as the
+     *                      hardware supports.  The result doesn't depend on nThreads.
+     *
+     * @returns statistics about the interpolation of each image
+     *
+     * @throws lsst::pex::exceptions::LengthError if any image's bounding box differs from getBBox()
+     * @throws lsst::pex::exceptions::InvalidParameterError if any image is null
+     */
+    template <typename MaskedImageT>
+    std::vector<DefectInterpolationStatistics> applyBatch(
+            std::vector<std::shared_ptr<MaskedImageT>> const &images, double fallbackValue = 0.0,
+            bool useFallbackValueAtEdge = false, int nThreads = 1) const;
+
+    /// Return the bounding box of the images that the plan may be applied to
+    geom::Box2I getBBox() const { return _bbox; }
+
+    /// Return the total number of runs of bad pixels in all rows and columns
+    std::size_t getNumRuns() const { return _runs.size() + _columnRuns.size(); }
+
+    /// Return the classified runs in row y (measured from the bottom of the bounding box)
+    std::vector<DefectRun> getRuns(int y) const;
+
+    /// Return the columns (measured from the left of the bounding box) interpolated vertically
+    std::vector<int> getColumns() const { return _columns; }
+
+    /**
+     * Return the classified runs in column x (measured from the left of the bounding box); x0 and x1
+     * are rows.  The list is empty unless x is one of getColumns()
+     */
+    std::vector<DefectRun> getColumnRuns(int x) const;
+
+    bool isPersistable() const noexcept override { return true; }
+
+    // Factory used to read DefectPlan from an InputArchive; defined only in the source file.
+    class Factory;
+
+protected:
+    // See afw::table::io::Persistable::getPersistenceName
+    std::string getPersistenceName() const override;
+
+    // See afw::table::io::Persistable::getPythonModule
+    std::string getPythonModule() const override;
+
+    // See afw::table::io::Persistable::write
+    void write(OutputArchiveHandle &handle) const override;
+
+private:
+    DefectPlan(geom::Box2I const &bbox, std::vector<std::size_t> rowBegin, std::vector<DefectRun> runs,
+               std::vector<int> columns, std::vector<std::size_t> columnBegin,
+               std::vector<DefectRun> columnRuns);
+
+    // Implementation of apply and applyBatch
+    template <typename MaskedImageT>
+    std::vector<DefectInterpolationStatistics> _apply(std::vector<MaskedImageT *> const &images,
+                                                      double fallbackValue, bool useFallbackValueAtEdge,
+                                                      int nThreads) const;
+
+    geom::Box2I _bbox;                   // bounding box of images we can be applied to
+    std::vector<std::size_t> _rowBegin;  // row y's runs are [_rowBegin[y], _rowBegin[y + 1]) in _runs
+    std::vector<DefectRun> _runs;        // classified runs, sorted by row and then x0
+    std::vector<int> _columns;           // columns interpolated vertically, sorted
+    std::vector<std::size_t> _columnBegin;  // _columns[i]'s runs are [_columnBegin[i], _columnBegin[i + 1])
+    std::vector<DefectRun> _columnRuns;     // classified runs in _columns, sorted by column and then row
+};
+
 template <typename MaskedImageT>
 void interpolateOverDefects(MaskedImageT &image, afw::detection::Psf const &psf,
                             std::vector<Defect::Ptr> &badList, double fallbackValue = 0.0,
-                            bool useFallbackValueAtEdge = false);
+                            bool useFallbackValueAtEdge = false, int nThreads = 1,
+                            double columnAspectRatio = 0.0);
+
+/**
+ * @brief Interpolate over the pixels of an image whose mask has any of the bits in bitmask set
+ *
+ * This is equivalent to interpolateOverDefects with a Defect for each bad pixel (and thus sets the
+ * INTRP bit for each of them), but reads the bad pixels directly from the image's mask.
+ *
+ * @param[in,out] image  Image to patch
+ * @param[in] bitmask  Bits identifying the pixels to interpolate over
+ * @param[in] fallbackValue  Value to fallback to if all else fails
+ * @param[in] useFallbackValueAtEdge  Use the fallback value at the image's edge?
+ * @param[in] nThreads  Number of threads to use; <= 0 means as many as the hardware supports
+ * @param[in] columnAspectRatio  Interpolate tall regions vertically; see DefectPlan
+ *
+ * @returns statistics about the interpolation
+ */
+template <typename MaskedImageT>
+DefectInterpolationStatistics interpolateOverMask(MaskedImageT &image,
+                                                  typename MaskedImageT::Mask::Pixel bitmask,
+                                                  double fallbackValue = 0.0,
+                                                  bool useFallbackValueAtEdge = false, int nThreads = 1,
+                                                  double columnAspectRatio = 0.0);
+
+/**
+ * @brief Write a list of Defects to a FITS binary table
+ *
+ * The table has a row for each defect, with integer columns x0, y0, width and height giving its
+ * bounding box.  Reading it back with readDefects is much faster than parsing a policy file.
+ *
+ * @param[in] fileName  Name of the file to write
+ * @param[in] badList  Defects to write
+ */
+void writeDefects(std::string const &fileName, std::vector<Defect::Ptr> const &badList);
+
+/**
+ * @brief Read a list of Defects from a FITS binary table written by writeDefects
+ *
+ * If the defects are always applied to images of the same size, a DefectPlan may be built once
+ * and saved with writeFits instead; DefectPlan::readFits then returns the plan ready to apply.
+ *
+ * @param[in] fileName  Name of the file to read
+ * @param[in] hdu  HDU of the table
+ *
+ * @returns the defects, in the order they were written
+ *
+ * @throws lsst::pex::exceptions::NotFoundError if the table lacks any of the required columns
+ * @throws lsst::pex::exceptions::InvalidParameterError if any defect is empty
+ */
+std::vector<Defect::Ptr> readDefects(std::string const &fileName, int hdu = afw::fits::DEFAULT_HDU);
 
 }  // namespace algorithms
 }  // namespace meas
@@ -62,6 +62,17 @@ public:
               CONST_PTR(afw::geom::TransformPoint2ToPoint2) distortion,
               std::string const& kernelName = "lanczos3", unsigned int cache = 10000);
 
+    /**
+     * @brief Construct WarpedPsf from unwarped psf, distortion, and the inverse of the distortion.
+     *
+     * Inverting the distortion is expensive, so this saves time when many WarpedPsfs are made with
+     * the same distortion; inverseDistortion must be equivalent to distortion->inverted()
+     */
+    WarpedPsf(CONST_PTR(afw::detection::Psf) undistortedPsf,
+              CONST_PTR(afw::geom::TransformPoint2ToPoint2) distortion,
+              CONST_PTR(afw::geom::TransformPoint2ToPoint2) inverseDistortion,
+              CONST_PTR(afw::math::WarpingControl) control);
+
     /**
      *  @brief Return the average of the positions of the stars that went into this Psf.
      *
@@ -85,6 +96,7 @@ protected:
 
 private:
     void _init();
+    PTR(afw::geom::TransformPoint2ToPoint2 const) _inverseDistortion;
     CONST_PTR(afw::math::WarpingControl) _warpingControl;
 
     virtual geom::Box2I doComputeBBox(geom::Point2D const& position, afw::image::Color const& color) const;
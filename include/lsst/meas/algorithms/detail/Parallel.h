@@ -0,0 +1,225 @@
+// -*- LSST-C++ -*-
+
+/*
+ * LSST Data Management System
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ * See the COPYRIGHT file
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#if !defined(LSST_MEAS_ALGORITHMS_DETAIL_PARALLEL_H)
+#define LSST_MEAS_ALGORITHMS_DETAIL_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lsst {
+namespace meas {
+namespace algorithms {
+namespace detail {
+
+/**
+ * Return the number of threads to use given a requested number; values <= 0 mean
+ * "as many as the hardware supports"
+ */
+inline int getThreadCount(int nThreads) {
+    if (nThreads > 0) {
+        return nThreads;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Call func(i) for each i in [0, n) using up to nThreads threads (see getThreadCount)
+ *
+ * Indices are handed out one at a time, so a thread that finishes early takes the next
+ * unclaimed index.  The calling thread does its share of the work.  If any call throws, the
+ * remaining indices are still processed and the exception from the lowest index is rethrown
+ * once all the threads have been joined; func must therefore be safe to call concurrently
+ * for distinct indices.
+ */
+template <typename Function>
+void parallelFor(int const n, int const nThreads, Function func) {
+    int const nThread = std::min(getThreadCount(nThreads), n);
+    if (nThread <= 1) {
+        for (int i = 0; i < n; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    std::atomic<int> next(0);                  // next index to process
+    std::vector<std::exception_ptr> errors(n);  // exceptions thrown by func, indexed by i
+    auto worker = [&]() {
+        for (int i = next++; i < n; i = next++) {
+            try {
+                func(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(nThread - 1);
+    for (int t = 1; t < nThread; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (auto const &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * A set of worker threads that are kept alive between calls to parallelFor
+ *
+ * Starting threads costs tens of microseconds each, which matters when the work is small and is
+ * repeated many times (e.g. warping a CoaddPsf's inputs for each source); a ThreadPool starts its
+ * threads once.  Only one parallelFor runs on the pool at a time; a call made while the pool is busy
+ * (e.g. from another thread, or from inside func) runs serially in the calling thread instead of
+ * waiting, so a pool may be shared freely.
+ */
+class ThreadPool {
+public:
+    /// Start getThreadCount(nThreads) - 1 threads; the thread calling parallelFor does its share too
+    explicit ThreadPool(int nThreads) {
+        int const nWorker = detail::getThreadCount(nThreads) - 1;
+        _workers.reserve(nWorker);
+        for (int t = 0; t < nWorker; ++t) {
+            _workers.emplace_back([this]() { _run(); });
+        }
+    }
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto &worker : _workers) {
+            worker.join();
+        }
+    }
+
+    /// Return the number of threads that share the work, including the caller's
+    int getThreadCount() const { return _workers.size() + 1; }
+
+    /**
+     * Call func(i) for each i in [0, n), as the free function parallelFor
+     *
+     * If any call throws, the remaining indices are still processed and the exception from the
+     * lowest index is rethrown.
+     */
+    template <typename Function>
+    void parallelFor(int const n, Function func) {
+        std::unique_lock<std::mutex> busy(_busy, std::try_to_lock);
+        if (!busy.owns_lock() || _workers.empty() || n <= 1) {
+            for (int i = 0; i < n; ++i) {
+                func(i);
+            }
+            return;
+        }
+
+        std::atomic<int> next(0);                  // next index to process
+        std::vector<std::exception_ptr> errors(n);  // exceptions thrown by func, indexed by i
+        std::function<void()> const task = [&]() {
+            for (int i = next++; i < n; i = next++) {
+                try {
+                    func(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &task;
+            _nRunning = _workers.size();
+            ++_generation;
+        }
+        _wake.notify_all();
+        task();
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [this]() { return _nRunning == 0; });
+            _task = nullptr;
+        }
+
+        for (auto const &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+private:
+    // The body of each worker thread:  run each task once, until told to stop
+    void _run() {
+        std::size_t generation = 0;  // the last task that we ran
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            _wake.wait(lock, [&]() { return _stop || _generation != generation; });
+            if (_stop) {
+                return;
+            }
+            generation = _generation;
+            std::function<void()> const *task = _task;
+            lock.unlock();
+            (*task)();  // never throws; the task catches func's exceptions
+            lock.lock();
+            if (--_nRunning == 0) {
+                _done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> _workers;
+    std::mutex _busy;                          // held while a parallelFor is using the workers
+    std::mutex _mutex;                         // protects the members below
+    std::condition_variable _wake;             // signalled when there's a new task, or on _stop
+    std::condition_variable _done;             // signalled when all the workers have finished a task
+    std::function<void()> const *_task = nullptr;  // the current task
+    std::size_t _generation = 0;               // number of tasks started
+    std::size_t _nRunning = 0;                 // number of workers still running the current task
+    bool _stop = false;                        // should the workers exit?
+};
+
+}  // namespace detail
+}  // namespace algorithms
+}  // namespace meas
+}  // namespace lsst
+
+#endif
@@ -20,6 +20,8 @@
  * see <https://www.lsstcorp.org/LegalNotices/>.
  */
 #include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+#include "ndarray/pybind11.h"
 
 #include "lsst/afw/table/io/python.h"
 #include "lsst/meas/algorithms/CoaddPsf.h"
@@ -34,11 +36,33 @@ namespace algorithms {
 namespace {
 
 PYBIND11_MODULE(coaddPsf, mod) {
+    py::module::import("lsst.afw.image");
+
     /* CoaddPsfControl */
     py::class_<CoaddPsfControl, std::shared_ptr<CoaddPsfControl>> clsControl(mod, "CoaddPsfControl");
-    clsControl.def(py::init<std::string, int>(), "warpingKernelName"_a = "lanczos3", "cacheSize"_a = 10000);
+    clsControl.def(py::init<std::string, int, double, double, int>(), "warpingKernelName"_a = "lanczos3",
+                   "cacheSize"_a = 10000, "kernelCacheCellSize"_a = 1.0, "kernelCacheMaxMemory"_a = 0.0,
+                   "nThreads"_a = 1);
     LSST_DECLARE_CONTROL_FIELD(clsControl, CoaddPsfControl, warpingKernelName);
     LSST_DECLARE_CONTROL_FIELD(clsControl, CoaddPsfControl, cacheSize);
+    LSST_DECLARE_CONTROL_FIELD(clsControl, CoaddPsfControl, kernelCacheCellSize);
+    LSST_DECLARE_CONTROL_FIELD(clsControl, CoaddPsfControl, kernelCacheMaxMemory);
+    LSST_DECLARE_CONTROL_FIELD(clsControl, CoaddPsfControl, nThreads);
+
+    /* CoaddPsfCacheStatistics */
+    py::class_<CoaddPsfCacheStatistics> clsStatistics(mod, "CoaddPsfCacheStatistics");
+    clsStatistics.def(py::init<>());
+    clsStatistics.def_readonly("nHit", &CoaddPsfCacheStatistics::nHit);
+    clsStatistics.def_readonly("nMiss", &CoaddPsfCacheStatistics::nMiss);
+    clsStatistics.def_readonly("nEvicted", &CoaddPsfCacheStatistics::nEvicted);
+    clsStatistics.def_readonly("nEntry", &CoaddPsfCacheStatistics::nEntry);
+    clsStatistics.def_readonly("memory", &CoaddPsfCacheStatistics::memory);
+
+    /* CoaddPsfKernelImageStack */
+    py::class_<CoaddPsfKernelImageStack> clsStack(mod, "CoaddPsfKernelImageStack");
+    clsStack.def(py::init<>());
+    clsStack.def_readonly("images", &CoaddPsfKernelImageStack::images);
+    clsStack.def_readonly("bbox", &CoaddPsfKernelImageStack::bbox);
 
     /* CoaddPsf */
     afw::table::io::python::declarePersistableFacade<CoaddPsf>(mod, "CoaddPsf");
@@ -66,6 +90,12 @@ PYBIND11_MODULE(coaddPsf, mod) {
     clsCoaddPsf.def("getId", &CoaddPsf::getId);
     clsCoaddPsf.def("getBBox", &CoaddPsf::getBBox);
     clsCoaddPsf.def("getValidPolygon", &CoaddPsf::getValidPolygon);
+    clsCoaddPsf.def("setKernelImageCache", &CoaddPsf::setKernelImageCache, "cellSize"_a, "maxMemory"_a);
+    clsCoaddPsf.def("getKernelImageCacheStatistics", &CoaddPsf::getKernelImageCacheStatistics);
+    clsCoaddPsf.def("computeKernelImages", &CoaddPsf::computeKernelImages, "positions"_a,
+                    "color"_a = afw::image::Color());
+    clsCoaddPsf.def("setNumThreads", &CoaddPsf::setNumThreads, "nThreads"_a);
+    clsCoaddPsf.def("getNumThreads", &CoaddPsf::getNumThreads);
     clsCoaddPsf.def("isPersistable", &CoaddPsf::isPersistable);
 }
 
@@ -20,6 +20,7 @@
  * see <https://www.lsstcorp.org/LegalNotices/>.
  */
 #include "pybind11/pybind11.h"
+#include "pybind11/functional.h"
 #include "pybind11/stl.h"
 
 #include "lsst/afw/detection/Footprint.h"
@@ -34,13 +35,52 @@ namespace meas {
 namespace algorithms {
 namespace {
 
+void declareCosmicRayStatistics(py::module& mod) {
+    py::class_<CosmicRayStatistics> cls(mod, "CosmicRayStatistics");
+
+    cls.def(py::init<>());
+
+    cls.def_readonly("detectTime", &CosmicRayStatistics::detectTime);
+    cls.def_readonly("mergeTime", &CosmicRayStatistics::mergeTime);
+    cls.def_readonly("filterTime", &CosmicRayStatistics::filterTime);
+    cls.def_readonly("removeTime", &CosmicRayStatistics::removeTime);
+    cls.def_readonly("growTime", &CosmicRayStatistics::growTime);
+    cls.def_readonly("totalTime", &CosmicRayStatistics::totalTime);
+    cls.def_readonly("nCandidate", &CosmicRayStatistics::nCandidate);
+    cls.def_readonly("nPixel", &CosmicRayStatistics::nPixel);
+    cls.def_readonly("nSpan", &CosmicRayStatistics::nSpan);
+    cls.def_readonly("nCrInitial", &CosmicRayStatistics::nCrInitial);
+    cls.def_readonly("nCr", &CosmicRayStatistics::nCr);
+    cls.def_readonly("nGrow", &CosmicRayStatistics::nGrow);
+}
+
 template <typename PixelT>
 void declareFindCosmicRays(py::module& mod) {
     mod.def("findCosmicRays", &findCosmicRays<afw::image::MaskedImage<PixelT>>, "image"_a, "psf"_a, "bkgd"_a,
-            "policy"_a, "keep"_a = false);
+            "policy"_a, "keep"_a = false, "stats"_a = nullptr);
+    mod.def("findCosmicRaysBatch", &findCosmicRaysBatch<afw::image::MaskedImage<PixelT>>, "images"_a,
+            "psfs"_a, "bkgds"_a, "policy"_a, "nThreads"_a = 0, "keep"_a = false);
+    mod.def("findCosmicRaysTiled",
+            py::overload_cast<afw::image::MaskedImage<PixelT>&, afw::detection::Psf const&, double const,
+                              pex::policy::Policy const&, int const, int const, int const, bool const>(
+                    &findCosmicRaysTiled<afw::image::MaskedImage<PixelT>>),
+            "image"_a, "psf"_a, "bkgd"_a, "policy"_a, "tileWidth"_a, "tileHeight"_a, "overlap"_a = 32,
+            "keep"_a = false);
+    mod.def("findCosmicRaysTiled",
+            py::overload_cast<lsst::geom::Box2I const&,
+                              std::function<std::shared_ptr<afw::image::MaskedImage<PixelT>>(
+                                      lsst::geom::Box2I const&)> const&,
+                              std::function<void(afw::image::MaskedImage<PixelT> const&,
+                                                 lsst::geom::Box2I const&)> const&,
+                              afw::detection::Psf const&, double const, pex::policy::Policy const&,
+                              int const, int const, int const, bool const>(
+                    &findCosmicRaysTiled<afw::image::MaskedImage<PixelT>>),
+            "bbox"_a, "readTile"_a, "writeTile"_a, "psf"_a, "bkgd"_a, "policy"_a, "tileWidth"_a,
+            "tileHeight"_a, "overlap"_a = 32, "keep"_a = false);
 }
 
 PYBIND11_MODULE(cr, mod) {
+    declareCosmicRayStatistics(mod);
     declareFindCosmicRays<float>(mod);
 }
 
@@ -24,7 +24,7 @@
 
 import lsst.geom
 import lsst.pex.policy as policy
-from . import Defect
+from . import Defect, writeDefects
 
 
 def policyToBadRegionList(policyFile):
@@ -53,3 +53,27 @@ def policyToBadRegionList(policyFile):
             badPixels.append(Defect(bbox))
 
     return badPixels
+
+
+def policyToDefectFile(policyFile, fileName):
+    """Convert a Policy file describing a CCD's bad pixels to a FITS table of defects
+
+    The table may be read with `lsst.meas.algorithms.readDefects`, which is much faster
+    than `policyToBadRegionList`.
+
+    Parameters
+    ----------
+    policyFile : `str`
+        Name of the Policy file to read.
+    fileName : `str`
+        Name of the FITS file to write.
+
+    Returns
+    -------
+    nDefect : `int`
+        Number of defects written.
+    """
+    badPixels = policyToBadRegionList(policyFile)
+    writeDefects(fileName, badPixels)
+
+    return len(badPixels)
@@ -57,6 +57,19 @@ class FindCosmicRaysConfig(pexConfig.Config):
         doc="number of times to look for contaminated pixels near known CR pixels",
         default=3,
     )
+    growFrontier = pexConfig.Field(
+        dtype=bool,
+        doc="On each of the niteration passes, only look for contaminated pixels next to the pixels found "
+        "in the previous pass, rather than around the whole CR.  This is much faster for large CRs, but as "
+        "pixels are examined in a different order the results may differ slightly",
+        default=False,
+    )
+    nThreads = pexConfig.Field(
+        dtype=int,
+        doc="number of threads used to search for CR pixels (the image is divided into this many bands of "
+        "rows); <= 0 means one per core.  The results do not depend on the number of threads",
+        default=1,
+    )
     keepCRs = pexConfig.Field(
         dtype=bool,
         doc="Don't interpolate over CR pixels",
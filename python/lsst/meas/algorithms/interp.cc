@@ -23,7 +23,9 @@
 #include "pybind11/stl.h"
 
 #include "lsst/geom/Box.h"
+#include "lsst/geom/Point.h"
 #include "lsst/afw/detection/Psf.h"
+#include "lsst/afw/table/io/python.h"
 #include "lsst/meas/algorithms/Interp.h"
 
 namespace py = pybind11;
@@ -39,7 +41,75 @@ void declareInterpolateOverDefects(py::module& mod) {
     mod.def("interpolateOverDefects",
             interpolateOverDefects<
                     afw::image::MaskedImage<PixelT, afw::image::MaskPixel, afw::image::VariancePixel>>,
-            "image"_a, "psf"_a, "badList"_a, "fallBackValue"_a = 0.0, "useFallbackValueAtEdge"_a = false);
+            "image"_a, "psf"_a, "badList"_a, "fallBackValue"_a = 0.0, "useFallbackValueAtEdge"_a = false,
+            "nThreads"_a = 1, "columnAspectRatio"_a = 0.0);
+    mod.def("interpolateOverMask",
+            interpolateOverMask<
+                    afw::image::MaskedImage<PixelT, afw::image::MaskPixel, afw::image::VariancePixel>>,
+            "image"_a, "bitmask"_a, "fallbackValue"_a = 0.0, "useFallbackValueAtEdge"_a = false,
+            "nThreads"_a = 1, "columnAspectRatio"_a = 0.0);
+}
+
+template <typename PixelT>
+void declareSinglePixel(py::module& mod) {
+    typedef afw::image::MaskedImage<PixelT, afw::image::MaskPixel, afw::image::VariancePixel> MaskedImageT;
+
+    mod.def("singlePixel", &interp::singlePixel<MaskedImageT>, "x"_a, "y"_a, "image"_a, "horizontal"_a,
+            "minval"_a, "badMask"_a = 0);
+    mod.def("singlePixels", &interp::singlePixels<MaskedImageT>, "positions"_a, "image"_a, "horizontal"_a,
+            "minval"_a, "badMask"_a = 0);
+}
+
+template <typename PixelT>
+void declareDefectPlanApply(py::class_<DefectPlan, std::shared_ptr<DefectPlan>,
+                                       afw::table::io::PersistableFacade<DefectPlan>,
+                                       afw::table::io::Persistable>& cls) {
+    cls.def("apply",
+            &DefectPlan::apply<
+                    afw::image::MaskedImage<PixelT, afw::image::MaskPixel, afw::image::VariancePixel>>,
+            "image"_a, "fallbackValue"_a = 0.0, "useFallbackValueAtEdge"_a = false, "nThreads"_a = 1);
+    cls.def("applyBatch",
+            &DefectPlan::applyBatch<
+                    afw::image::MaskedImage<PixelT, afw::image::MaskPixel, afw::image::VariancePixel>>,
+            "images"_a, "fallbackValue"_a = 0.0, "useFallbackValueAtEdge"_a = false, "nThreads"_a = 1);
+}
+
+void declareDefectPlan(py::module& mod) {
+    py::class_<DefectRun> clsDefectRun(mod, "DefectRun");
+
+    clsDefectRun.def_readonly("x0", &DefectRun::x0);
+    clsDefectRun.def_readonly("x1", &DefectRun::x1);
+    clsDefectRun.def_readonly("pos", &DefectRun::pos);
+    clsDefectRun.def_readonly("type", &DefectRun::type);
+
+    py::class_<DefectInterpolationStatistics> clsStatistics(mod, "DefectInterpolationStatistics");
+
+    clsStatistics.def(py::init<>());
+
+    clsStatistics.def_readonly("nPixel", &DefectInterpolationStatistics::nPixel);
+    clsStatistics.def_readonly("nFallback", &DefectInterpolationStatistics::nFallback);
+    clsStatistics.def_readonly("nNonFinite", &DefectInterpolationStatistics::nNonFinite);
+
+    afw::table::io::python::declarePersistableFacade<DefectPlan>(mod, "DefectPlan");
+
+    py::class_<DefectPlan, std::shared_ptr<DefectPlan>, afw::table::io::PersistableFacade<DefectPlan>,
+               afw::table::io::Persistable>
+            clsDefectPlan(mod, "DefectPlan");
+
+    clsDefectPlan.def(py::init<std::vector<Defect::Ptr> const&, geom::Box2I const&, double>(), "badList"_a,
+                      "bbox"_a, "columnAspectRatio"_a = 0.0);
+    clsDefectPlan.def(py::init<afw::image::Mask<afw::image::MaskPixel> const&, afw::image::MaskPixel,
+                               double>(),
+                      "mask"_a, "bitmask"_a, "columnAspectRatio"_a = 0.0);
+
+    declareDefectPlanApply<float>(clsDefectPlan);
+    declareDefectPlanApply<double>(clsDefectPlan);
+    clsDefectPlan.def("getBBox", &DefectPlan::getBBox);
+    clsDefectPlan.def("getNumRuns", &DefectPlan::getNumRuns);
+    clsDefectPlan.def("getRuns", &DefectPlan::getRuns, "y"_a);
+    clsDefectPlan.def("getColumns", &DefectPlan::getColumns);
+    clsDefectPlan.def("getColumnRuns", &DefectPlan::getColumnRuns, "x"_a);
+    clsDefectPlan.def("isPersistable", &DefectPlan::isPersistable);
 }
 
 PYBIND11_MODULE(interp, mod) {
@@ -66,7 +136,12 @@ PYBIND11_MODULE(interp, mod) {
     clsDefect.def("getType", &Defect::getType);
     clsDefect.def("getPos", &Defect::getPos);
 
+    mod.def("writeDefects", &writeDefects, "fileName"_a, "badList"_a);
+    mod.def("readDefects", &readDefects, "fileName"_a, "hdu"_a = afw::fits::DEFAULT_HDU);
+
+    declareDefectPlan(mod);
     declareInterpolateOverDefects<float>(mod);
+    declareSinglePixel<float>(mod);
 }
 
 }  // namespace
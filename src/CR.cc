@@ -31,9 +31,17 @@
  */
 #include <stdexcept>
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
 #include <string>
 #include <typeinfo>
+#include <utility>
 
 #include <iostream>
 
@@ -45,67 +53,11 @@
 #include "lsst/afw/detection/Footprint.h"
 #include "lsst/afw/geom.h"
 #include "lsst/afw/detection/Psf.h"
+#include "lsst/geom/Angle.h"
 #include "lsst/afw/image/MaskedImage.h"
-#include "lsst/afw/math/Random.h"
 #include "lsst/meas/algorithms/CR.h"
 #include "lsst/meas/algorithms/Interp.h"
-
-/**
- * @todo These should go into afw --- actually, there're already there, but
- * in an anon namespace
- */
-namespace lsst {
-namespace afw {
-namespace detection {
-/**
- * run-length code for part of object
- */
-class IdSpan {
-public:
-    typedef std::shared_ptr<IdSpan> Ptr;
-    typedef std::shared_ptr<const IdSpan> ConstPtr;
-
-    explicit IdSpan(int id, int y, int x0, int x1) : id(id), y(y), x0(x0), x1(x1) {}
-    int id;     /* ID for object */
-    int y;      /* Row wherein IdSpan dwells */
-    int x0, x1; /* inclusive range of columns */
-};
-/**
- * comparison functor; sort by ID, then by row (y), then by column range start (x0)
- */
-struct IdSpanCompar : public std::binary_function<const IdSpan::ConstPtr, const IdSpan::ConstPtr, bool> {
-    bool operator()(const IdSpan::ConstPtr a, const IdSpan::ConstPtr b) {
-        if (a->id < b->id) {
-            return true;
-        } else if (a->id > b->id) {
-            return false;
-        } else {
-            if (a->y < b->y) {
-                return true;
-            } else if (a->y > b->y) {
-                return false;
-            } else {
-                return (a->x0 < b->x0) ? true : false;
-            }
-        }
-    }
-};
-/**
- * Follow a chain of aliases, returning the final resolved value.
- */
-int resolve_alias(const std::vector<int> &aliases, /* list of aliases */
-                  int id) {                        /* alias to look up */
-    int resolved = id;                             /* resolved alias */
-
-    while (id != aliases[id]) {
-        resolved = id = aliases[id];
-    }
-
-    return (resolved);
-}
-}  // namespace detection
-}  // namespace afw
-}  // namespace lsst
+#include "lsst/meas/algorithms/detail/Parallel.h"
 
 namespace lsst {
 namespace meas {
@@ -116,7 +68,8 @@ namespace {
 template <typename ImageT, typename MaskT>
 void removeCR(afw::image::MaskedImage<ImageT, MaskT> &mi,
               std::vector<std::shared_ptr<afw::detection::Footprint>> &CRs, double const bkgd, MaskT const,
-              MaskT const saturBit, MaskT const badMask, bool const debias, bool const grow);
+              MaskT const saturBit, MaskT const badMask, bool const debias, bool const grow,
+              int const nThreads);
 
 template <typename ImageT>
 bool condition_3(ImageT *estimate, double const peak, double const mean_ns, double const mean_we,
@@ -145,27 +98,74 @@ struct CRPixel {
     int row;     //    of pixel
     ImageT val;  // initial value of pixel
 private:
-    static int i;    // current value of running index
-    int mutable _i;  // running index
+    static std::atomic<int> i;  // current value of running index; CRPixels may be created by many threads
+    int mutable _i;             // running index
 };
 
 template <typename ImageT>
-int CRPixel<ImageT>::i = 0;
+std::atomic<int> CRPixel<ImageT>::i(0);
 
 template <typename ImageT>
 struct Sort_CRPixel_by_id {
     bool operator()(CRPixel<ImageT> const &a, CRPixel<ImageT> const &b) const { return a.id < b.id; }
 };
 
+/************************************************************************************************************/
+//
+// The spans of the (pieces of) CRs, stored as parallel arrays so that there's no allocation per span
+//
+struct IdSpans {
+    explicit IdSpans(std::size_t n = 0) {
+        id.reserve(n);
+        y.reserve(n);
+        x0.reserve(n);
+        x1.reserve(n);
+    }
+
+    std::size_t size() const { return id.size(); }
+
+    void push_back(int const id_, int const y_, int const x0_, int const x1_) {
+        id.push_back(id_);
+        y.push_back(y_);
+        x0.push_back(x0_);
+        x1.push_back(x1_);
+    }
+
+    std::vector<int> id;      // ID for object
+    std::vector<int> y;       // Row wherein span dwells
+    std::vector<int> x0, x1;  // inclusive range of columns
+};
+
+//
+// Follow a chain of aliases, returning the final resolved value, and point every alias on the
+// chain directly at it so that later lookups are fast.  The resolved value is unchanged.
+//
+int resolveAlias(std::vector<int> &aliases,  // list of aliases
+                 int const id                // alias to look up
+) {
+    int resolved = id;
+    while (resolved != aliases[resolved]) {
+        resolved = aliases[resolved];
+    }
+
+    for (int i = id; i != resolved;) {
+        int const next = aliases[i];
+        aliases[i] = resolved;
+        i = next;
+    }
+
+    return resolved;
+}
+
 /*****************************************************************************/
 /*
  * This is the code to see if a given pixel is bad
  *
  * Note that the pixel in question is at index 0, so its value is pt_0[0]
  */
-template <typename MaskedImageT>
+template <typename MaskedImageT, typename LocatorT = typename MaskedImageT::xy_locator>
 bool is_cr_pixel(typename MaskedImageT::Image::Pixel *corr,  // corrected value
-                 typename MaskedImageT::xy_locator loc,      // locator for this pixel
+                 LocatorT loc,                               // locator for this pixel
                  double const minSigma,                      // minSigma, or -threshold if negative
                  double const thresH, double const thresV, double const thresD,  // for condition #3
                  double const bkgd,     // unsubtracted background level
@@ -228,6 +228,133 @@ bool is_cr_pixel(typename MaskedImageT::Image::Pixel *corr,  // corrected value
     return true;
 }
 
+/************************************************************************************************************/
+//
+// Access to a pixel and its neighbours for findCrPixelsInRows.  The generic version uses the
+// MaskedImage's xy_locators
+//
+template <typename MaskedImageT>
+class CrPixelAccessor {
+public:
+    typedef typename MaskedImageT::Image::Pixel ImagePixel;
+    typedef typename MaskedImageT::Mask::Pixel MaskPixel;
+    typedef typename MaskedImageT::xy_locator Locator;
+
+    explicit CrPixelAccessor(MaskedImageT &mimage) : _mimage(mimage) {}
+
+    // Return a locator for pixel (i, j), for use with is_cr_pixel
+    Locator locator(int const i, int const j) const { return _mimage.xy_at(i, j); }
+    // The pixel's mask value
+    static MaskPixel mask(Locator &loc) { return loc.mask(); }
+    // The OR of the mask values of the pixel's eight neighbours
+    static MaskPixel neighbourMask(Locator &loc) {
+        return loc.mask(-1, 1) | loc.mask(0, 1) | loc.mask(1, 1) | loc.mask(-1, 0) | loc.mask(1, 0) |
+               loc.mask(-1, -1) | loc.mask(0, -1) | loc.mask(1, -1);
+    }
+    // Get and set the pixel's value
+    static ImagePixel getImage(Locator &loc) { return loc.image(); }
+    static void setImage(Locator &loc, ImagePixel const value) { loc.image() = value; }
+
+private:
+    MaskedImageT &_mimage;
+};
+
+//
+// Specialisation for the common case of float images, using raw pointers into the rows of the
+// image, mask, and variance (which must be contiguous in x)
+//
+template <>
+class CrPixelAccessor<afw::image::MaskedImage<float>> {
+public:
+    typedef afw::image::MaskedImage<float> MaskedImageT;
+    typedef MaskedImageT::Image::Pixel ImagePixel;
+    typedef MaskedImageT::Mask::Pixel MaskPixel;
+    typedef MaskedImageT::Variance::Pixel VariancePixel;
+    //
+    // Pointers to the pixel in the rows below, at, and above the pixel, indexed by dy + 1
+    //
+    struct Locator {
+        ImagePixel image(int const dx, int const dy) const { return imageRows[dy + 1][dx]; }
+        VariancePixel variance(int const dx, int const dy) const { return varianceRows[dy + 1][dx]; }
+
+        ImagePixel *imageRows[3];
+        MaskPixel const *maskRows[3];
+        VariancePixel const *varianceRows[3];
+    };
+
+    explicit CrPixelAccessor(MaskedImageT &mimage)
+            : _imageArray(mimage.getImage()->getArray()),
+              _maskArray(mimage.getMask()->getArray()),
+              _varianceArray(mimage.getVariance()->getArray()),
+              _imageStride(_imageArray.getStrides()[0]),
+              _maskStride(_maskArray.getStrides()[0]),
+              _varianceStride(_varianceArray.getStrides()[0]) {}
+
+    Locator locator(int const i, int const j) const {
+        Locator loc;
+        for (int dy = -1; dy <= 1; ++dy) {
+            loc.imageRows[dy + 1] = _imageArray.getData() + (j + dy) * _imageStride + i;
+            loc.maskRows[dy + 1] = _maskArray.getData() + (j + dy) * _maskStride + i;
+            loc.varianceRows[dy + 1] = _varianceArray.getData() + (j + dy) * _varianceStride + i;
+        }
+        return loc;
+    }
+    static MaskPixel mask(Locator const &loc) { return loc.maskRows[1][0]; }
+    static MaskPixel neighbourMask(Locator const &loc) {
+        MaskPixel const *below = loc.maskRows[0];
+        MaskPixel const *row = loc.maskRows[1];
+        MaskPixel const *above = loc.maskRows[2];
+        return (below[-1] | below[0] | below[1]) | (row[-1] | row[1]) | (above[-1] | above[0] | above[1]);
+    }
+    static ImagePixel getImage(Locator const &loc) { return loc.imageRows[1][0]; }
+    static void setImage(Locator &loc, ImagePixel const value) { loc.imageRows[1][0] = value; }
+
+private:
+    ndarray::Array<ImagePixel, 2, 1> _imageArray;
+    ndarray::Array<MaskPixel, 2, 1> _maskArray;
+    ndarray::Array<VariancePixel, 2, 1> _varianceArray;
+    std::ptrdiff_t _imageStride, _maskStride, _varianceStride;
+};
+
+/************************************************************************************************************/
+//
+// A cheap first pass of is_cr_pixel's tests over a row of the image; pass[i] is set to 0 if pixel i
+// (1 <= i < ncol - 1) would certainly fail, and 1 if it needs the full test.
+//
+// The arithmetic (including the float means and the double threshold) is identical to is_cr_pixel's,
+// so no pixel that is_cr_pixel would accept is rejected.  The loops have no branches or function
+// calls, and the rows are contiguous, so the compiler is able to vectorise them.
+//
+template <typename ImagePixel, typename VariancePixel>
+void prescreenRow(ImagePixel const *below,    // row j - 1
+                  ImagePixel const *row,      // row j
+                  ImagePixel const *above,    // row j + 1
+                  VariancePixel const *var,   // variance of row j
+                  int const ncol,             // number of pixels in a row
+                  double const minSigma,      // minSigma, or -threshold if negative
+                  unsigned char *pass         // 1 if pixel needs to be checked with is_cr_pixel
+) {
+    if (minSigma < 0) {
+        for (int i = 1; i < ncol - 1; ++i) {
+            ImagePixel const v_00 = row[i];
+            pass[i] = !(v_00 < 0) & !(v_00 < -minSigma);
+        }
+    } else {
+        for (int i = 1; i < ncol - 1; ++i) {
+            ImagePixel const v_00 = row[i];
+            ImagePixel const mean_we = (row[i - 1] + row[i + 1]) / 2;
+            ImagePixel const mean_ns = (above[i] + below[i]) / 2;
+            ImagePixel const mean_swne = (below[i - 1] + above[i + 1]) / 2;
+            ImagePixel const mean_nwse = (above[i - 1] + below[i + 1]) / 2;
+            double const thres_sky_sigma = minSigma * sqrt(var[i]);
+
+            pass[i] = !(v_00 < 0) &
+                      !((v_00 < mean_ns + thres_sky_sigma) & (v_00 < mean_we + thres_sky_sigma) &
+                        (v_00 < mean_swne + thres_sky_sigma) & (v_00 < mean_nwse + thres_sky_sigma));
+        }
+    }
+}
+
 /************************************************************************************************************/
 //
 // Worker routine to process the pixels adjacent to a span (including the points just
@@ -268,6 +395,366 @@ void checkSpanForCRs(afw::detection::Footprint *extras,  // Extra spans get adde
     }
 }
 
+/************************************************************************************************************/
+//
+// Look for extra CR pixels next to the pixels that were added to each CR in the previous iteration, and
+// add them to the CR.
+//
+// The pixels examined are those within one pixel (including diagonally) of newSpans[i] that aren't
+// already part of CR i and that aren't on the edge of the image; they're examined in row order.  Pixels
+// found are appended to spans[i], and replace the contents of newSpans[i].
+//
+// Returns the number of pixels added, or -1 if adding the pixels for a CR would exceed nCrPixelMax
+// (in which case that CR's pixels aren't added, and no further CRs are processed)
+//
+template <typename MaskedImageT>
+int growCRsFromFrontier(std::vector<std::vector<afw::geom::Span>> &spans,  // spans of each CR
+                        std::vector<std::vector<afw::geom::Span>> &newSpans,  // newly added spans
+                        std::vector<CRPixel<typename MaskedImageT::Image::Pixel>> &crpixels,
+                        // a list of pixels containing CRs
+                        MaskedImageT &image,    // Image to search
+                        double const minSigma,  // minSigma
+                        double const thresH, double const thresV, double const thresD,  // for cond. #3
+                        double const bkgd,      // unsubtracted background level
+                        bool const keep,        // if true, don't remove the CRs
+                        int const nextra,       // number of pixels already added
+                        int const nCrPixelMax   // maximum number of contaminated pixels
+) {
+    typedef typename MaskedImageT::Image::Pixel MImagePixel;
+
+    int const imageX0 = image.getX0();
+    int const imageY0 = image.getY0();
+    geom::Box2I const interior(geom::Point2I(imageX0 + 1, imageY0 + 1),
+                               geom::Extent2I(image.getWidth() - 2, image.getHeight() - 2));
+
+    int nadded = 0;  // number of pixels added in this iteration
+    std::vector<afw::geom::Span> added;
+    for (std::size_t i = 0; i != spans.size(); ++i) {
+        if (newSpans[i].empty()) {
+            continue;
+        }
+        afw::geom::SpanSet const cr(spans[i]);
+        auto const frontier = afw::geom::SpanSet(std::move(newSpans[i]))
+                                      .dilated(1, afw::geom::Stencil::BOX)
+                                      ->clippedTo(interior)
+                                      ->intersectNot(cr);
+        newSpans[i].clear();
+
+        added.clear();
+        for (auto const &span : *frontier) {
+            int const y = span.getY() - imageY0;
+            typename MaskedImageT::xy_locator loc = image.xy_at(span.getX0() - imageX0, y);
+            for (int x = span.getX0() - imageX0; x <= span.getX1() - imageX0; ++x, ++loc.x()) {
+                MImagePixel corr = 0;  // new value for pixel
+                if (is_cr_pixel<MaskedImageT>(&corr, loc, minSigma, thresH, thresV, thresD, bkgd, 0)) {
+                    if (keep) {
+                        crpixels.push_back(CRPixel<MImagePixel>(x + imageX0, y + imageY0, loc.image()));
+                    }
+                    loc.image() = corr;
+
+                    if (!added.empty() && added.back().getY() == y + imageY0 &&
+                        added.back().getX1() == x + imageX0 - 1) {
+                        added.back() = afw::geom::Span(y + imageY0, added.back().getX0(), x + imageX0);
+                    } else {
+                        added.push_back(afw::geom::Span(y + imageY0, x + imageX0, x + imageX0));
+                    }
+                }
+            }
+        }
+
+        if (!added.empty()) {
+            int npixel = 0;
+            for (auto const &span : added) {
+                npixel += span.getWidth();
+            }
+            if (nextra + nadded + static_cast<int>(crpixels.size()) > nCrPixelMax) {
+                return -1;
+            }
+            nadded += npixel;
+
+            spans[i].insert(spans[i].end(), added.begin(), added.end());
+            newSpans[i] = added;
+        }
+    }
+
+    return nadded;
+}
+
+/************************************************************************************************************/
+//
+// Search rows [y0, y1) of an image for CR-contaminated pixels, appending them to crpixels in the
+// order that they're found.
+//
+// Contaminated pixels are replaced with reasonable values as we go through the image, which
+// increases the detection rate; this means that the results for a row depend on the results for
+// the rows (and pixels) that precede it.
+//
+// Returns false (leaving the processed pixels corrected) if more than nCrPixelMax pixels are found
+//
+template <typename MaskedImageT>
+bool findCrPixelsInRows(MaskedImageT &mimage,  // Image to search
+                        int const y0, int const y1,  // range of rows to search (y1 is exclusive)
+                        std::vector<CRPixel<typename MaskedImageT::Image::Pixel>> &crpixels,
+                        // a list of pixels containing CRs
+                        double const minSigma,  // minSigma
+                        double const thresH, double const thresV, double const thresD,  // for cond. #3
+                        double const bkgd,                                // unsubtracted background level
+                        double const cond3Fac,                            // fiddle factor for condition #3
+                        typename MaskedImageT::Mask::Pixel const badMask,    // naughty pixels
+                        typename MaskedImageT::Mask::Pixel const interpBit,  // interpolated pixels
+                        int const nCrPixelMax,  // maximum number of contaminated pixels
+                        long *nCandidate = nullptr  // incremented by the number of pixels given the full test
+) {
+    typedef typename MaskedImageT::Image::Pixel ImagePixel;
+    typedef typename MaskedImageT::Variance::Pixel VariancePixel;
+
+    int const ncol = mimage.getWidth();
+
+    auto const imageArray = mimage.getImage()->getArray();
+    auto const varianceArray = mimage.getVariance()->getArray();
+    std::ptrdiff_t const imageStride = imageArray.getStrides()[0];
+    std::ptrdiff_t const varianceStride = varianceArray.getStrides()[0];
+
+    std::vector<unsigned char> pass(ncol, 0);  // 1 if the pixel survived prescreenRow
+    std::vector<int> candidates;               // the columns of the pixels that survived
+    candidates.reserve(ncol);
+    //
+    // Apply the full test to pixel (i, j), correcting it if it's a CR.  Returns true iff it was corrected
+    //
+    bool tooMany = false;
+    typedef CrPixelAccessor<MaskedImageT> Accessor;
+    Accessor const accessor(mimage);
+
+    auto checkPixel = [&](int const i, int const j) {
+        typename Accessor::Locator loc = accessor.locator(i, j);  // locator for data
+        if (nCandidate) {
+            ++*nCandidate;
+        }
+
+        ImagePixel corr = 0;
+        if (!is_cr_pixel<MaskedImageT>(&corr, loc, minSigma, thresH, thresV, thresD, bkgd, cond3Fac)) {
+            return false;
+        }
+        /*
+         * condition #4
+         */
+        if (Accessor::mask(loc) & badMask) {
+            return false;
+        }
+        if (Accessor::neighbourMask(loc) & interpBit) {
+            return false;
+        }
+        /*
+         * OK, it's a CR
+         */
+        crpixels.push_back(
+                CRPixel<ImagePixel>(i + mimage.getX0(), j + mimage.getY0(), Accessor::getImage(loc)));
+        Accessor::setImage(loc, corr); /* just a preliminary estimate */
+
+        if (static_cast<int>(crpixels.size()) > nCrPixelMax) {
+            tooMany = true;
+        }
+        return true;
+    };
+
+    for (int j = y0; j < y1; ++j) {
+        ImagePixel const *row = imageArray.getData() + j * imageStride;
+        VariancePixel const *var = varianceArray.getData() + j * varianceStride;
+        prescreenRow(row - imageStride, row, row + imageStride, var, ncol, minSigma, pass.data());
+
+        candidates.clear();
+        for (int i = 1; i < ncol - 1; ++i) {
+            if (pass[i]) {
+                candidates.push_back(i);
+            }
+        }
+        //
+        // The prescreen used the row's values before any of its pixels were corrected; correcting a
+        // pixel changes its right-hand neighbour's mean_we, so that neighbour must get the full test too
+        //
+        int const ncandidate = candidates.size();
+        for (int k = 0; k < ncandidate; ++k) {
+            for (int i = candidates[k]; checkPixel(i, j); ++i) {
+                if (tooMany) {
+                    return false;
+                }
+                if (i + 1 == ncol - 1 || (k + 1 < ncandidate && candidates[k + 1] == i + 1)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// Band b of the image was searched as if the row just below it was uncorrected; if the band below
+// actually found contaminated pixels in that row the assumption was wrong, so re-search the band's
+// rows in order (as the serial code would have) until the results agree with the ones we already had.
+//
+// The band is a deep copy of its rows, plus a halo row above and below; its crpixels are in the
+// order found, i.e. sorted by row then column.
+//
+template <typename MaskedImageT>
+void restitchBand(MaskedImageT &band,                                      // the band to correct
+                  std::vector<CRPixel<typename MaskedImageT::Image::Pixel>> &crpixels,  // its CR pixels
+                  MaskedImageT const &below,  // the (final) band just below this one
+                  std::vector<CRPixel<typename MaskedImageT::Image::Pixel>> const &crpixelsBelow,
+                  double const minSigma, double const thresH, double const thresV, double const thresD,
+                  double const bkgd, double const cond3Fac, typename MaskedImageT::Mask::Pixel const badMask,
+                  typename MaskedImageT::Mask::Pixel const interpBit) {
+    typedef typename MaskedImageT::Image::Pixel ImagePixel;
+    typedef CRPixel<ImagePixel> CRPixelT;
+    typedef typename std::vector<CRPixelT>::iterator crpixel_iter;
+
+    auto const rowLess = [](CRPixelT const &crp, int row) { return crp.row < row; };
+    auto const lessRow = [](int row, CRPixelT const &crp) { return row < crp.row; };
+
+    int const x0 = band.getX0();
+    int const y0 = band.getY0();  // row of our lower halo; the last row searched by the band below
+    typename MaskedImageT::Image &image = *band.getImage();
+    /*
+     * Copy the corrections made by the band below into our halo
+     */
+    bool corrected = false;  // did the band below correct any pixels in our halo?
+    for (auto crp = std::lower_bound(crpixelsBelow.begin(), crpixelsBelow.end(), y0, rowLess);
+         crp != crpixelsBelow.end(); ++crp) {
+        image(crp->col - x0, 0) = (*below.getImage())(crp->col - below.getX0(), crp->row - below.getY0());
+        corrected = true;
+    }
+    if (!corrected) {
+        return;
+    }
+
+    int const nrow = band.getHeight();
+    for (int j = 1; j < nrow - 1; ++j) {
+        int const row = j + y0;
+        std::size_t const begin = std::lower_bound(crpixels.begin(), crpixels.end(), row, rowLess) -
+                                  crpixels.begin();
+        std::size_t const end = std::upper_bound(crpixels.begin(), crpixels.end(), row, lessRow) -
+                                crpixels.begin();
+        std::size_t const next = std::upper_bound(crpixels.begin(), crpixels.end(), row + 1, lessRow) -
+                                 crpixels.begin();
+        /*
+         * Remember the corrected values in this row and the next, and reset them to their initial values
+         */
+        std::vector<ImagePixel> correctedVals;
+        correctedVals.reserve(next - begin);
+        for (std::size_t k = begin; k != next; ++k) {
+            ImagePixel &pix = image(crpixels[k].col - x0, crpixels[k].row - y0);
+            correctedVals.push_back(pix);
+            pix = crpixels[k].val;
+        }
+        /*
+         * Search this row again
+         */
+        std::vector<CRPixelT> found;
+        findCrPixelsInRows(band, j, j + 1, found, minSigma, thresH, thresV, thresD, bkgd, cond3Fac, badMask,
+                           interpBit, std::numeric_limits<int>::max());
+        /*
+         * Reinstate the corrections in the next row, and see if anything changed in this one
+         */
+        for (std::size_t k = end; k != next; ++k) {
+            image(crpixels[k].col - x0, crpixels[k].row - y0) = correctedVals[k - begin];
+        }
+
+        bool same = (found.size() == end - begin);
+        for (std::size_t k = 0; same && k != found.size(); ++k) {
+            same = (found[k].col == crpixels[begin + k].col &&
+                    image(found[k].col - x0, j) == correctedVals[k]);
+        }
+        if (same) {  // the rest of the band is unaffected
+            return;
+        }
+
+        crpixel_iter const pos = crpixels.erase(crpixels.begin() + begin, crpixels.begin() + end);
+        crpixels.insert(pos, found.begin(), found.end());
+    }
+}
+
+//
+// Search an image for CR-contaminated pixels (see findCrPixelsInRows) by dividing it into nBand
+// horizontal bands which are searched in parallel.
+//
+// Each band is searched in a private copy of the image, and the bands are then stitched together in
+// order (see restitchBand); the pixels found and their corrected values are identical to those from
+// searching the whole image in a single pass.  The image is only modified if we succeed.
+//
+template <typename MaskedImageT>
+bool findCrPixelsInBands(MaskedImageT &mimage,  // Image to search
+                         int const nBand,       // number of bands (and threads) to use
+                         std::vector<CRPixel<typename MaskedImageT::Image::Pixel>> &crpixels,
+                         // a list of pixels containing CRs
+                         double const minSigma, double const thresH, double const thresV, double const thresD,
+                         double const bkgd, double const cond3Fac,
+                         typename MaskedImageT::Mask::Pixel const badMask,
+                         typename MaskedImageT::Mask::Pixel const interpBit, int const nCrPixelMax,
+                         long *nCandidate = nullptr  // incremented by number of pixels given the full test
+) {
+    typedef CRPixel<typename MaskedImageT::Image::Pixel> CRPixelT;
+
+    int const ncol = mimage.getWidth();
+    int const nrow = mimage.getHeight();
+    /*
+     * Band b searches rows [ybands[b], ybands[b + 1]); we ignore the edge rows
+     */
+    std::vector<int> ybands(nBand + 1);
+    for (int b = 0; b <= nBand; ++b) {
+        ybands[b] = 1 + static_cast<int>((static_cast<long>(nrow - 2) * b) / nBand);
+    }
+
+    std::vector<std::shared_ptr<MaskedImageT>> bands(nBand);
+    std::vector<std::vector<CRPixelT>> bandCrpixels(nBand);
+    std::vector<int> ok(nBand, 0);  // n.b. not vector<bool>, as it's written by many threads
+    std::vector<long> nBandCandidate(nBand, 0);
+
+    detail::parallelFor(nBand, nBand, [&](int b) {
+        geom::Box2I const bbox(geom::Point2I(0, ybands[b] - 1),
+                               geom::Extent2I(ncol, ybands[b + 1] - ybands[b] + 2));
+        bands[b] = std::make_shared<MaskedImageT>(mimage, bbox, afw::image::LOCAL, true);
+
+        ok[b] = findCrPixelsInRows(*bands[b], 1, bbox.getHeight() - 1, bandCrpixels[b], minSigma, thresH,
+                                   thresV, thresD, bkgd, cond3Fac, badMask, interpBit, nCrPixelMax,
+                                   &nBandCandidate[b]);
+    });
+    if (nCandidate) {
+        for (auto n : nBandCandidate) {
+            *nCandidate += n;
+        }
+    }
+
+    std::size_t npixel = 0;
+    for (int b = 0; b != nBand; ++b) {
+        if (!ok[b]) {
+            return false;
+        }
+        if (b > 0) {
+            restitchBand(*bands[b], bandCrpixels[b], *bands[b - 1], bandCrpixels[b - 1], minSigma, thresH,
+                         thresV, thresD, bkgd, cond3Fac, badMask, interpBit);
+        }
+        npixel += bandCrpixels[b].size();
+    }
+    if (npixel > static_cast<std::size_t>(nCrPixelMax)) {
+        return false;
+    }
+    /*
+     * Copy the corrected pixels back into the image
+     */
+    typename MaskedImageT::Image &image = *mimage.getImage();
+    crpixels.reserve(crpixels.size() + npixel);
+    for (int b = 0; b != nBand; ++b) {
+        typename MaskedImageT::Image const &bandImage = *bands[b]->getImage();
+        for (auto const &crp : bandCrpixels[b]) {
+            image(crp.col - mimage.getX0(), crp.row - mimage.getY0()) =
+                    bandImage(crp.col - bands[b]->getX0(), crp.row - bands[b]->getY0());
+            crpixels.push_back(crp);
+        }
+    }
+
+    return true;
+}
+
 /************************************************************************************************************/
 /*
  * Find the sum of the pixels in a Footprint
@@ -306,36 +793,46 @@ static void reinstateCrPixels(
     }
 }
 
-/*!
- * @brief Find cosmic rays in an Image, and mask and remove them
- *
- * @return vector of CR's Footprints
+namespace {
+/*
+ * The parameters that control findCosmicRays, parsed from its Policy
  */
-template <typename MaskedImageT>
-std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
-        MaskedImageT &mimage,               ///< Image to search
-        afw::detection::Psf const &psf,     ///< the Image's PSF
-        double const bkgd,                  ///< unsubtracted background of frame, DN
-        pex::policy::Policy const &policy,  ///< Policy directing the behavior
-        bool const keep                     ///< if true, don't remove the CRs
-) {
-    typedef typename MaskedImageT::Image ImageT;
-    typedef typename ImageT::Pixel ImagePixel;
-    typedef typename MaskedImageT::Mask::Pixel MaskPixel;
+struct CrParameters {
+    explicit CrParameters(pex::policy::Policy const &policy)
+            : minSigma(policy.getDouble("minSigma")),
+              minDn(policy.getDouble("min_DN")),
+              cond3Fac(policy.getDouble("cond3_fac")),
+              cond3Fac2(policy.getDouble("cond3_fac2")),
+              niteration(policy.getInt("niteration")),
+              nCrPixelMax(policy.getInt("nCrPixelMax")),
+              nThreads(policy.exists("nThreads") ? policy.getInt("nThreads") : 1),
+              growFrontier(policy.exists("growFrontier") && policy.getBool("growFrontier")) {}
+
+    double minSigma;  // min sigma over sky in pixel for CR candidate
+    double minDn;     // min number of DN in an CRs
+    double cond3Fac;  // fiddle factor for condition #3
+    double cond3Fac2;  // 2nd fiddle factor for condition #3
+    int niteration;   // Number of times to look for contaminated pixels near CRs
+    int nCrPixelMax;  // maximum number of contaminated pixels
+    int nThreads;     // threads for search
+    bool growFrontier;  // only look for extra pixels next to the ones added in the previous iteration
+};
+
+/*
+ * The thresholds for condition #3, derived from the PSF
+ */
+struct CrThresholds {
+    double thresH;  // horizontal
+    double thresV;  // vertical
+    double thresD;  // diagonal
+};
 
-    // Parse the Policy
-    double const minSigma = policy.getDouble("minSigma");     // min sigma over sky in pixel for CR candidate
-    double const minDn = policy.getDouble("min_DN");          // min number of DN in an CRs
-    double const cond3Fac = policy.getDouble("cond3_fac");    // fiddle factor for condition #3
-    double const cond3Fac2 = policy.getDouble("cond3_fac2");  // 2nd fiddle factor for condition #3
-    int const niteration = policy.getInt("niteration");       // Number of times to look for contaminated
-                                                              // pixels near CRs
-    int const nCrPixelMax = policy.getInt("nCrPixelMax");     // maximum number of contaminated pixels
-                                                              /*
-                                                               * thresholds for 3rd condition
-                                                               *
-                                                               * Realise PSF at center of image
-                                                               */
+/*
+ * Calculate the thresholds for the 3rd condition by realising the PSF at the center of the image
+ */
+CrThresholds computeThresholds(afw::detection::Psf const &psf,  // the Image's PSF
+                               double const cond3Fac2             // 2nd fiddle factor for condition #3
+) {
     std::shared_ptr<afw::math::Kernel const> kernel = psf.getLocalKernel();
     if (!kernel) {
         throw LSST_EXCEPT(pexExcept::NotFoundError, "Psf is unable to return a kernel");
@@ -348,16 +845,56 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
     int const yc = kernel->getCtrY();
 
     double const I0 = psfImage(xc, yc);
-    double const thresH =
+    CrThresholds thresholds;
+    thresholds.thresH =
             cond3Fac2 * (0.5 * (psfImage(xc - 1, yc) + psfImage(xc + 1, yc))) / I0;  // horizontal
-    double const thresV = cond3Fac2 * (0.5 * (psfImage(xc, yc - 1) + psfImage(xc, yc + 1))) / I0;  // vertical
-    double const thresD = cond3Fac2 *
-                          (0.25 * (psfImage(xc - 1, yc - 1) + psfImage(xc + 1, yc + 1) +
-                                   psfImage(xc - 1, yc + 1) + psfImage(xc + 1, yc - 1))) /
-                          I0;                                                  // diag
-                                                                               /*
-                                                                                * Setup desired mask planes
-                                                                                */
+    thresholds.thresV =
+            cond3Fac2 * (0.5 * (psfImage(xc, yc - 1) + psfImage(xc, yc + 1))) / I0;  // vertical
+    thresholds.thresD = cond3Fac2 *
+                        (0.25 * (psfImage(xc - 1, yc - 1) + psfImage(xc + 1, yc + 1) +
+                                 psfImage(xc - 1, yc + 1) + psfImage(xc + 1, yc - 1))) /
+                        I0;  // diag
+
+    return thresholds;
+}
+
+/*
+ * Return the wall-clock time in seconds since start
+ */
+double secondsSince(std::chrono::steady_clock::time_point const &start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Find cosmic rays in an Image, and mask and remove them; see findCosmicRays
+ */
+template <typename MaskedImageT>
+std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRaysImpl(
+        MaskedImageT &mimage,              // Image to search
+        double const bkgd,                 // unsubtracted background of frame, DN
+        CrParameters const &params,        // parameters directing the behavior
+        CrThresholds const &thresholds,    // thresholds for condition #3
+        bool const keep,                   // if true, don't remove the CRs
+        CosmicRayStatistics *stats         // if not null, timings and counts for each phase
+) {
+    typedef typename MaskedImageT::Image ImageT;
+    typedef typename ImageT::Pixel ImagePixel;
+    typedef typename MaskedImageT::Mask::Pixel MaskPixel;
+
+    double const minSigma = params.minSigma;
+    double const minDn = params.minDn;
+    double const cond3Fac = params.cond3Fac;
+    int const niteration = params.niteration;
+    int const nCrPixelMax = params.nCrPixelMax;
+    int const nThreads = params.nThreads;
+    bool const growFrontier = params.growFrontier;
+
+    double const thresH = thresholds.thresH;
+    double const thresV = thresholds.thresV;
+    double const thresD = thresholds.thresD;
+    /*
+     * Setup desired mask planes
+     */
     MaskPixel const badBit = mimage.getMask()->getPlaneBitMask("BAD");         // Generic bad pixels
     MaskPixel const crBit = mimage.getMask()->getPlaneBitMask("CR");           // CR-contaminated pixels
     MaskPixel const interpBit = mimage.getMask()->getPlaneBitMask("INTRP");    // Interpolated pixels
@@ -365,9 +902,9 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
     MaskPixel const nodataBit = mimage.getMask()->getPlaneBitMask("NO_DATA");  // Non data pixels
 
     MaskPixel const badMask = (badBit | interpBit | saturBit | nodataBit);  // naughty pixels
-                                                                            /*
-                                                                             * Go through the frame looking at each pixel (except the edge ones which we ignore)
-                                                                             */
+    /*
+     * Go through the frame looking at each pixel (except the edge ones which we ignore)
+     */
     int const ncol = mimage.getWidth();
     int const nrow = mimage.getHeight();
 
@@ -375,41 +912,28 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
     typedef typename std::vector<CRPixel<ImagePixel>>::iterator crpixel_iter;
     typedef typename std::vector<CRPixel<ImagePixel>>::reverse_iterator crpixel_riter;
 
-    for (int j = 1; j < nrow - 1; ++j) {
-        typename MaskedImageT::xy_locator loc = mimage.xy_at(1, j);  // locator for data
-
-        for (int i = 1; i < ncol - 1; ++i, ++loc.x()) {
-            ImagePixel corr = 0;
-            if (!is_cr_pixel<MaskedImageT>(&corr, loc, minSigma, thresH, thresV, thresD, bkgd, cond3Fac)) {
-                continue;
-            }
-            /*
-             * condition #4
-             */
-            if (loc.mask() & badMask) {
-                continue;
-            }
-            if ((loc.mask(-1, 1) | loc.mask(0, 1) | loc.mask(1, 1) | loc.mask(-1, 0) | loc.mask(1, 0) |
-                 loc.mask(-1, -1) | loc.mask(0, -1) | loc.mask(1, -1)) &
-                interpBit) {
-                continue;
-            }
-            /*
-             * OK, it's a CR
-             *
-             * replace CR-contaminated pixels with reasonable values as we go through
-             * image, which increases the detection rate
-             */
-            crpixels.push_back(CRPixel<ImagePixel>(i + mimage.getX0(), j + mimage.getY0(), loc.image()));
-            loc.image() = corr; /* just a preliminary estimate */
+    auto phaseStart = std::chrono::steady_clock::now();  // start of the current phase
+    long nCandidate = 0;                             // number of pixels given the full test
+
+    int const nBand = std::min(detail::getThreadCount(nThreads), (nrow - 2) / 2);  // need >= 2 rows per band
+    bool const ok = (nBand > 1) ? findCrPixelsInBands(mimage, nBand, crpixels, minSigma, thresH, thresV,
+                                                      thresD, bkgd, cond3Fac, badMask, interpBit, nCrPixelMax,
+                                                      &nCandidate)
+                                : findCrPixelsInRows(mimage, 1, nrow - 1, crpixels, minSigma, thresH, thresV,
+                                                     thresD, bkgd, cond3Fac, badMask, interpBit, nCrPixelMax,
+                                                     &nCandidate);
+    if (stats) {
+        stats->detectTime = secondsSince(phaseStart);
+        stats->nCandidate = nCandidate;
+        stats->nPixel = crpixels.size();
+    }
+    phaseStart = std::chrono::steady_clock::now();
 
-            if (static_cast<int>(crpixels.size()) > nCrPixelMax) {
-                reinstateCrPixels(mimage.getImage().get(), crpixels);
+    if (!ok) {
+        reinstateCrPixels(mimage.getImage().get(), crpixels);
 
-                throw LSST_EXCEPT(pex::exceptions::LengthError,
-                                  (boost::format("Too many CR pixels (max %d)") % nCrPixelMax).str());
-            }
-        }
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          (boost::format("Too many CR pixels (max %d)") % nCrPixelMax).str());
     }
     /*
      * We've found them on a pixel-by-pixel basis, now merge those pixels
@@ -418,8 +942,7 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
     std::vector<int> aliases;                  // aliases for initially disjoint parts of CRs
     aliases.reserve(1 + crpixels.size() / 2);  // initial size of aliases
 
-    std::vector<afw::detection::IdSpan::Ptr> spans;  // y:x0,x1 for objects
-    spans.reserve(aliases.capacity());               // initial size of spans
+    IdSpans spans(aliases.capacity());  // y:x0,x1 for objects
 
     aliases.push_back(0);  // 0 --> 0
 
@@ -459,7 +982,7 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
                 ++x1;
             } else {
                 assert(y >= 0 && x0 >= 0 && x1 >= 0);
-                spans.push_back(afw::detection::IdSpan::Ptr(new afw::detection::IdSpan(id, y, x0, x1)));
+                spans.push_back(id, y, x0, x1);
                 // printf("  Not adjoining; adding span id=%i, y=%i, x = [%i, %i]\n", id, y, x0, x1);
             }
         }
@@ -479,62 +1002,67 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
         assert(crpixels[crpixels.size() - 1].row == -1);
     }
 
-    for (std::vector<afw::detection::IdSpan::Ptr>::iterator sp = spans.begin(), end = spans.end(); sp != end;
-         sp++) {
-        assert((*sp)->id >= 0);
-        assert((*sp)->y >= 0);
-        assert((*sp)->x0 >= 0);
-        assert((*sp)->x1 >= (*sp)->x0);
-        for (std::vector<afw::detection::IdSpan::Ptr>::iterator sp2 = sp + 1; sp2 != end; sp2++) {
-            assert((*sp2)->y >= (*sp)->y);
-            if ((*sp2)->y == (*sp)->y) {
-                assert((*sp2)->x0 > (*sp)->x1);
-            }
-        }
+    int const nspan = spans.size();
+    for (int i = 0; i < nspan; ++i) {
+        assert(spans.id[i] >= 0);
+        assert(spans.y[i] >= 0);
+        assert(spans.x0[i] >= 0);
+        assert(spans.x1[i] >= spans.x0[i]);
+        // The spans are sorted by row, then column
+        assert(i == 0 || spans.y[i] > spans.y[i - 1] ||
+               (spans.y[i] == spans.y[i - 1] && spans.x0[i] > spans.x1[i - 1]));
     }
 
     /*
      * See if spans touch each other
      */
-    for (std::vector<afw::detection::IdSpan::Ptr>::iterator sp = spans.begin(), end = spans.end(); sp != end;
-         ++sp) {
-        int const y = (*sp)->y;
-        int const x0 = (*sp)->x0;
-        int const x1 = (*sp)->x1;
+    for (int i = 0; i < nspan; ++i) {
+        int const y = spans.y[i];
+        int const x0 = spans.x0[i];
+        int const x1 = spans.x1[i];
 
         // this loop will probably run for only a few steps
-        for (std::vector<afw::detection::IdSpan::Ptr>::iterator sp2 = sp + 1; sp2 != end; ++sp2) {
-            if ((*sp2)->y == y) {
+        for (int i2 = i + 1; i2 < nspan; ++i2) {
+            if (spans.y[i2] == y) {
                 // on this row (but not adjoining columns, since it would have been merged into this span);
                 // keep looking.
                 continue;
-            } else if ((*sp2)->y != (y + 1)) {
-                // sp2 is more than one row below; can't be connected.
+            } else if (spans.y[i2] != (y + 1)) {
+                // i2 is more than one row below; can't be connected.
                 break;
-            } else if ((*sp2)->x0 > (x1 + 1)) {
-                // sp2 is more than one column away to the right; can't be connected
+            } else if (spans.x0[i2] > (x1 + 1)) {
+                // i2 is more than one column away to the right; can't be connected
                 break;
-            } else if ((*sp2)->x1 >= (x0 - 1)) {
+            } else if (spans.x1[i2] >= (x0 - 1)) {
                 // touches
-                int r1 = afw::detection::resolve_alias(aliases, (*sp)->id);
-                int r2 = afw::detection::resolve_alias(aliases, (*sp2)->id);
+                int r1 = resolveAlias(aliases, spans.id[i]);
+                int r2 = resolveAlias(aliases, spans.id[i2]);
                 aliases[r1] = r2;
             }
         }
     }
 
     /*
-     * Resolve aliases; first alias chains, then the IDs in the spans
+     * Resolve aliases in the spans' IDs, and count the spans in each object
      */
-    for (unsigned int i = 0; i != spans.size(); ++i) {
-        spans[i]->id = afw::detection::resolve_alias(aliases, spans[i]->id);
+    std::vector<int> start(ncr + 2, 0);  // index of first span of each object, once accumulated
+    for (int i = 0; i < nspan; ++i) {
+        spans.id[i] = resolveAlias(aliases, spans.id[i]);
+        ++start[spans.id[i] + 1];
+    }
+    for (int id = 0; id <= ncr; ++id) {
+        start[id + 1] += start[id];
     }
 
     /*
-     * Sort spans by ID, so we can sweep through them once
+     * Sort spans by ID; a counting sort is stable, so each object's spans stay sorted by row then column
      */
-    if (spans.size() > 0) {
-        std::sort(spans.begin(), spans.end(), afw::detection::IdSpanCompar());
+    std::vector<int> order(nspan);  // indices of spans, sorted by ID
+    {
+        std::vector<int> next(start.begin(), start.end() - 1);  // next free slot for each ID
+        for (int i = 0; i < nspan; ++i) {
+            order[next[spans.id[i]]++] = i;
+        }
     }
 
     /*
@@ -542,28 +1070,29 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
      */
     std::vector<std::shared_ptr<afw::detection::Footprint>> CRs;  // our cosmic rays
 
-    if (spans.size() > 0) {
-        int id = spans[0]->id;
-        unsigned int i0 = 0;                                 // initial value of i
-        for (unsigned int i = i0; i <= spans.size(); ++i) {  // <= size to catch the last object
-            if (i == spans.size() || spans[i]->id != id) {
-                std::shared_ptr<afw::detection::Footprint> cr(new afw::detection::Footprint());
-
-                std::vector<afw::geom::Span> spanList;
-                spanList.reserve(i - i0);
-                for (; i0 < i; ++i0) {
-                    spanList.push_back(afw::geom::Span(spans[i0]->y, spans[i0]->x0, spans[i0]->x1));
-                }
-                cr->setSpans(std::make_shared<afw::geom::SpanSet>(std::move(spanList)));
-                CRs.push_back(cr);
-            }
+    for (int id = 0; id <= ncr; ++id) {
+        if (start[id] == start[id + 1]) {  // not a root; merged into another CR
+            continue;
+        }
+        std::shared_ptr<afw::detection::Footprint> cr(new afw::detection::Footprint());
 
-            if (i < spans.size()) {
-                id = spans[i]->id;
-            }
+        std::vector<afw::geom::Span> spanList;
+        spanList.reserve(start[id + 1] - start[id]);
+        for (int k = start[id]; k < start[id + 1]; ++k) {
+            int const i = order[k];
+            spanList.push_back(afw::geom::Span(spans.y[i], spans.x0[i], spans.x1[i]));
         }
+        cr->setSpans(std::make_shared<afw::geom::SpanSet>(std::move(spanList)));
+        CRs.push_back(cr);
     }
 
+    if (stats) {
+        stats->mergeTime = secondsSince(phaseStart);
+        stats->nSpan = nspan;
+        stats->nCrInitial = CRs.size();
+    }
+    phaseStart = std::chrono::steady_clock::now();
+
     reinstateCrPixels(mimage.getImage().get(), crpixels);
     /*
      * apply condition #1
@@ -586,13 +1115,37 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
         CountDN.reset();
     }
     ncr = CRs.size(); /* some may have been too faint */
-                      /*
-                       * We've found them all, time to kill them all
-                       */
+    if (stats) {
+        stats->filterTime = secondsSince(phaseStart);
+        stats->nCr = ncr;
+    }
+    phaseStart = std::chrono::steady_clock::now();
+    /*
+     * We've found them all, time to kill them all
+     */
     bool const debias_values = true;
     bool grow = false;
     LOGL_DEBUG("TRACE2.algorithms.CR", "Removing initial list of CRs");
-    removeCR(mimage, CRs, bkgd, crBit, saturBit, badMask, debias_values, grow);
+    /*
+     * removeCR expects the CRs to be labelled.  If we give up because there are too many CR pixels the
+     * caller's mask must be left as it was, so remember the original values
+     */
+    std::vector<std::shared_ptr<afw::geom::SpanSet>> labelledSpans;
+    std::vector<MaskPixel> unlabelledMask;
+    for (auto const &foot : CRs) {
+        labelledSpans.push_back(foot->getSpans());
+        for (auto const &span : *foot->getSpans()) {
+            MaskPixel const *row = &(*mimage.getMask())(span.getX0() - mimage.getX0(),
+                                                         span.getY() - mimage.getY0());
+            unlabelledMask.insert(unlabelledMask.end(), row, row + span.getWidth());
+        }
+        foot->getSpans()->setMask(*mimage.getMask().get(), crBit);
+    }
+    removeCR(mimage, CRs, bkgd, crBit, saturBit, badMask, debias_values, grow, nThreads);
+    if (stats) {
+        stats->removeTime = secondsSince(phaseStart);
+    }
+    phaseStart = std::chrono::steady_clock::now();
 #if 0  // Useful to see phase 2 in display; debugging only
     (void)setMaskFromFootprintList(mimage.getMask().get(), CRs,
                                    mimage.getMask()->getPlaneBitMask("DETECTED"));
@@ -606,8 +1159,45 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
      */
     bool too_many_crs = false;  // we've seen too many CR pixels
     int nextra = 0;             // number of pixels added to list of CRs
-    for (int i = 0; i != niteration && !too_many_crs; ++i) {
+    if (growFrontier) {
+        /*
+         * Only look at pixels next to the ones that were added in the previous iteration (initially,
+         * all of the CR's pixels), and only build the CRs' SpanSets when we're done
+         */
+        int const ncr = CRs.size();
+        std::vector<std::vector<afw::geom::Span>> spans(ncr);
+        std::vector<std::vector<afw::geom::Span>> newSpans(ncr);
+        for (int i = 0; i != ncr; ++i) {
+            spans[i].assign(CRs[i]->getSpans()->begin(), CRs[i]->getSpans()->end());
+            newSpans[i] = spans[i];
+        }
+
+        for (int i = 0; i != niteration; ++i) {
+            LOGL_DEBUG("TRACE1.algorithms.CR", "Starting iteration %d", i);
+            int const nadded = growCRsFromFrontier(spans, newSpans, crpixels, mimage, minSigma / 2, thresH,
+                                                   thresV, thresD, bkgd, keep, nextra, nCrPixelMax);
+            if (nadded < 0) {
+                too_many_crs = true;
+                break;
+            }
+            if (stats) {
+                stats->nGrow.push_back(nadded);
+            }
+            if (nadded == 0) {
+                break;
+            }
+            nextra += nadded;
+        }
+
+        for (int i = 0; i != ncr; ++i) {
+            if (spans[i].size() != CRs[i]->getSpans()->size()) {
+                CRs[i]->setSpans(std::make_shared<afw::geom::SpanSet>(std::move(spans[i])));
+            }
+        }
+    }
+    for (int i = 0; i != niteration && !too_many_crs && !growFrontier; ++i) {
         LOGL_DEBUG("TRACE1.algorithms.CR", "Starting iteration %d", i);
+        int const nextra0 = nextra;  // value of nextra at start of iteration
         for (std::vector<std::shared_ptr<afw::detection::Footprint>>::iterator fiter = CRs.begin();
              fiter != CRs.end(); fiter++) {
             std::shared_ptr<afw::detection::Footprint> cr = *fiter;
@@ -671,11 +1261,18 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
                 cr->setSpans(std::make_shared<afw::geom::SpanSet>(std::move(tmpSpanList)));
             }
         }
+        if (stats) {
+            stats->nGrow.push_back(nextra - nextra0);
+        }
 
         if (nextra == 0) {
             break;
         }
     }
+    if (stats) {
+        stats->growTime = secondsSince(phaseStart);
+    }
+    phaseStart = std::chrono::steady_clock::now();
     /*
      * mark those pixels as CRs
      */
@@ -710,7 +1307,10 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
         if (true || nextra > 0) {
             grow = true;
             LOGL_DEBUG("TRACE2.algorithms.CR", "Removing final list of CRs, grow = %d", grow);
-            removeCR(mimage, CRs, bkgd, crBit, saturBit, badMask, debias_values, grow);
+            removeCR(mimage, CRs, bkgd, crBit, saturBit, badMask, debias_values, grow, nThreads);
+            if (stats) {
+                stats->removeTime += secondsSince(phaseStart);
+            }
         }
         /*
          * we interpolated over all CR pixels, so set the interp bits too
@@ -720,13 +1320,266 @@ std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
         }
     }
 
-    if (too_many_crs) {  // we've cleaned up, so we can throw the exception
+    if (too_many_crs) {  // restore the mask, and give up
+        MaskPixel const *value = unlabelledMask.data();
+        for (auto const &spans : labelledSpans) {
+            for (auto const &span : *spans) {
+                MaskPixel *row = &(*mimage.getMask())(span.getX0() - mimage.getX0(),
+                                                       span.getY() - mimage.getY0());
+                std::copy(value, value + span.getWidth(), row);
+                value += span.getWidth();
+            }
+        }
+        // we've cleaned up, so we can throw the exception
         throw LSST_EXCEPT(pex::exceptions::LengthError,
                           (boost::format("Too many CR pixels (max %d)") % nCrPixelMax).str());
     }
 
     return CRs;
 }
+}  // namespace
+
+/*!
+ * @brief Find cosmic rays in an Image, and mask and remove them
+ *
+ * @return vector of CR's Footprints
+ */
+template <typename MaskedImageT>
+std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(
+        MaskedImageT &mimage,               ///< Image to search
+        afw::detection::Psf const &psf,     ///< the Image's PSF
+        double const bkgd,                  ///< unsubtracted background of frame, DN
+        pex::policy::Policy const &policy,  ///< Policy directing the behavior
+        bool const keep,                    ///< if true, don't remove the CRs
+        CosmicRayStatistics *stats          ///< if not null, timings and counts for each phase
+) {
+    auto const start = std::chrono::steady_clock::now();
+    if (stats) {
+        *stats = CosmicRayStatistics();
+    }
+
+    CrParameters const params(policy);
+    CrThresholds const thresholds = computeThresholds(psf, params.cond3Fac2);
+    auto CRs = findCosmicRaysImpl(mimage, bkgd, params, thresholds, keep, stats);
+
+    if (stats) {
+        stats->totalTime = secondsSince(start);
+    }
+    return CRs;
+}
+
+template <typename MaskedImageT>
+std::vector<std::vector<std::shared_ptr<afw::detection::Footprint>>> findCosmicRaysBatch(
+        std::vector<std::shared_ptr<MaskedImageT>> const &images,
+        std::vector<std::shared_ptr<afw::detection::Psf const>> const &psfs, std::vector<double> const &bkgds,
+        pex::policy::Policy const &policy, int const nThreads, bool const keep) {
+    int const nImage = images.size();
+    if (psfs.size() != images.size() || bkgds.size() != images.size()) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          (boost::format("Saw %d images but %d PSFs and %d backgrounds") % nImage %
+                           psfs.size() % bkgds.size())
+                                  .str());
+    }
+
+    CrParameters params(policy);
+    if (std::min(detail::getThreadCount(nThreads), nImage) > 1) {
+        params.nThreads = 1;  // we're already using all our threads
+    }
+    /*
+     * Realising the PSFs isn't guaranteed to be thread-safe, so calculate all the thresholds first;
+     * images that share a Psf share its thresholds
+     */
+    std::map<afw::detection::Psf const *, CrThresholds> thresholdCache;
+    std::vector<CrThresholds const *> thresholds(nImage);
+    for (int i = 0; i < nImage; ++i) {
+        if (!images[i] || !psfs[i]) {
+            throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                              (boost::format("Image or PSF %d is null") % i).str());
+        }
+        auto iter = thresholdCache.find(psfs[i].get());
+        if (iter == thresholdCache.end()) {
+            iter = thresholdCache.emplace(psfs[i].get(), computeThresholds(*psfs[i], params.cond3Fac2)).first;
+        }
+        thresholds[i] = &iter->second;
+    }
+
+    std::vector<std::vector<std::shared_ptr<afw::detection::Footprint>>> CRs(nImage);
+    detail::parallelFor(nImage, nThreads, [&](int i) {
+        CRs[i] = findCosmicRaysImpl(*images[i], bkgds[i], params, *thresholds[i], keep, nullptr);
+    });
+
+    return CRs;
+}
+
+template <typename MaskedImageT>
+std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRaysTiled(
+        geom::Box2I const &bbox,
+        std::function<std::shared_ptr<MaskedImageT>(geom::Box2I const &)> const &readTile,
+        std::function<void(MaskedImageT const &, geom::Box2I const &)> const &writeTile,
+        afw::detection::Psf const &psf, double const bkgd, pex::policy::Policy const &policy,
+        int const tileWidth, int const tileHeight, int const overlap, bool const keep) {
+    if (tileWidth <= 0 || tileHeight <= 0 || overlap < 0) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          (boost::format("Invalid tile size %dx%d or overlap %d") % tileWidth % tileHeight %
+                           overlap)
+                                  .str());
+    }
+    CrParameters const params(policy);
+    CrThresholds const thresholds = computeThresholds(psf, params.cond3Fac2);
+    /*
+     * Find the CRs in each tile, keeping the parts that lie in the part of the image that the tile owns
+     */
+    std::vector<geom::Box2I> owners;     // the part of the image owned by each tile
+    std::vector<geom::Box2I> tileBBoxes;  // the part of the image read for each tile
+    for (int y0 = bbox.getMinY(); y0 <= bbox.getMaxY(); y0 += tileHeight) {
+        for (int x0 = bbox.getMinX(); x0 <= bbox.getMaxX(); x0 += tileWidth) {
+            geom::Box2I const core(geom::Point2I(x0, y0),
+                                   geom::Point2I(std::min(x0 + tileWidth - 1, bbox.getMaxX()),
+                                                 std::min(y0 + tileHeight - 1, bbox.getMaxY())));
+            geom::Box2I tileBBox(core);
+            tileBBox.grow(overlap);
+            tileBBox.clip(bbox);
+            owners.push_back(core);
+            tileBBoxes.push_back(tileBBox);
+        }
+    }
+    /*
+     * Every tile must see the original pixels, so a tile's pixels can't be written until all the tiles
+     * that read any of them have been processed.  Tiles are processed in order, so that's the last tile
+     * that overlaps this one
+     */
+    int const ntile = owners.size();
+    std::vector<int> lastReader(ntile);
+    for (int i = 0; i < ntile; ++i) {
+        lastReader[i] = i;
+        for (int j = i + 1; j < ntile; ++j) {
+            if (tileBBoxes[j].overlaps(owners[i])) {
+                lastReader[i] = j;
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<afw::geom::SpanSet>> pieces;  // parts of CRs found in each tile
+    std::vector<int> ownerOf;                                 // index into owners for each piece
+    std::vector<std::pair<int, std::shared_ptr<MaskedImageT>>> unwritten;  // processed tiles, in order
+
+    for (int i = 0; i < ntile; ++i) {
+        geom::Box2I const &core = owners[i];
+        std::shared_ptr<MaskedImageT> tile = readTile(tileBBoxes[i]);
+        if (!tile || tile->getBBox() != tileBBoxes[i]) {
+            throw LSST_EXCEPT(pex::exceptions::RuntimeError, "readTile returned an image of the wrong size");
+        }
+
+        auto const crs = findCosmicRaysImpl(*tile, bkgd, params, thresholds, keep, nullptr);
+        for (auto const &cr : crs) {
+            if (!cr->getBBox().overlaps(core)) {
+                continue;  // another tile owns this CR
+            }
+            auto spans = cr->getSpans()->clippedTo(core);
+            if (spans->getArea() > 0) {
+                pieces.push_back(spans);
+                ownerOf.push_back(i);
+            }
+        }
+
+        unwritten.emplace_back(i, tile);
+        std::vector<std::pair<int, std::shared_ptr<MaskedImageT>>> stillRead;  // tiles we can't write yet
+        for (auto &done : unwritten) {
+            if (lastReader[done.first] <= i) {
+                writeTile(*done.second, owners[done.first]);
+            } else {
+                stillRead.push_back(std::move(done));
+            }
+        }
+        unwritten.swap(stillRead);
+    }
+    /*
+     * Merge pieces of the same CR that were found in adjacent tiles.  Only pieces that reach the edge
+     * of the region owned by their tile can touch a piece owned by another tile
+     */
+    int const npiece = pieces.size();
+    std::vector<int> aliases(npiece);  // union-find forest of pieces
+    for (int i = 0; i < npiece; ++i) {
+        aliases[i] = i;
+    }
+
+    std::vector<int> edgePieces;  // indices of pieces that reach the edge of their tile
+    std::vector<geom::Box2I> grownBBoxes(npiece);
+    for (int i = 0; i < npiece; ++i) {
+        grownBBoxes[i] = pieces[i]->getBBox();
+        grownBBoxes[i].grow(1);
+        if (!owners[ownerOf[i]].contains(grownBBoxes[i])) {
+            edgePieces.push_back(i);
+        }
+    }
+    std::sort(edgePieces.begin(), edgePieces.end(), [&grownBBoxes](int a, int b) {
+        return grownBBoxes[a].getMinY() < grownBBoxes[b].getMinY();
+    });
+
+    int const nedge = edgePieces.size();
+    for (int k = 0; k < nedge; ++k) {
+        int const i = edgePieces[k];
+        std::shared_ptr<afw::geom::SpanSet> grown;  // piece i, grown by a pixel in all 8 directions
+        for (int k2 = k + 1; k2 < nedge; ++k2) {
+            int const i2 = edgePieces[k2];
+            if (grownBBoxes[i2].getMinY() > grownBBoxes[i].getMaxY()) {
+                break;
+            }
+            if (ownerOf[i2] == ownerOf[i] || !grownBBoxes[i].overlaps(grownBBoxes[i2])) {
+                continue;
+            }
+            if (!grown) {
+                grown = pieces[i]->dilated(1, afw::geom::Stencil::BOX);
+            }
+            if (grown->overlaps(*pieces[i2])) {
+                int const r1 = resolveAlias(aliases, i);
+                int const r2 = resolveAlias(aliases, i2);
+                aliases[r1] = r2;
+            }
+        }
+    }
+    /*
+     * Build a Footprint for each set of pieces
+     */
+    std::vector<std::vector<afw::geom::Span>> spanLists(npiece);
+    for (int i = 0; i < npiece; ++i) {
+        auto &spanList = spanLists[resolveAlias(aliases, i)];
+        spanList.insert(spanList.end(), pieces[i]->begin(), pieces[i]->end());
+    }
+
+    std::vector<std::shared_ptr<afw::detection::Footprint>> CRs;
+    for (auto &spanList : spanLists) {
+        if (!spanList.empty()) {
+            auto cr = std::make_shared<afw::detection::Footprint>();
+            cr->setSpans(std::make_shared<afw::geom::SpanSet>(std::move(spanList)));
+            CRs.push_back(cr);
+        }
+    }
+    std::sort(CRs.begin(), CRs.end(), [](std::shared_ptr<afw::detection::Footprint> const &a,
+                                         std::shared_ptr<afw::detection::Footprint> const &b) {
+        afw::geom::Span const &sa = *a->getSpans()->begin();
+        afw::geom::Span const &sb = *b->getSpans()->begin();
+        return (sa.getY() < sb.getY()) || (sa.getY() == sb.getY() && sa.getX0() < sb.getX0());
+    });
+
+    return CRs;
+}
+
+template <typename MaskedImageT>
+std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRaysTiled(
+        MaskedImageT &image, afw::detection::Psf const &psf, double const bkgd,
+        pex::policy::Policy const &policy, int const tileWidth, int const tileHeight, int const overlap,
+        bool const keep) {
+    auto readTile = [&image](geom::Box2I const &bbox) {
+        return std::make_shared<MaskedImageT>(image, bbox, afw::image::PARENT, true);
+    };
+    auto writeTile = [&image](MaskedImageT const &tile, geom::Box2I const &bbox) {
+        image.assign(MaskedImageT(tile, bbox, afw::image::PARENT), bbox, afw::image::PARENT);
+    };
+
+    return findCosmicRaysTiled<MaskedImageT>(image.getBBox(), readTile, writeTile, psf, bkgd, policy,
+                                             tileWidth, tileHeight, overlap, keep);
+}
 
 /*****************************************************************************/
 namespace {
@@ -775,116 +1628,105 @@ bool condition_3(ImageT *estimate,         // estimate of true value of pixel
 
 /************************************************************************************************************/
 /*
- * Interpolate over a CR's pixels
+ * A counter-based source of Gaussian deviates: each deviate is a function of the pixel's position, a seed,
+ * and a stream number, so the values don't depend on the order in which pixels are processed (and thus on
+ * the number of threads being used)
+ */
+class CounterGaussian {
+public:
+    explicit CounterGaussian(std::uint64_t const seed) : _seed(seed) {}
+
+    double operator()(int const x, int const y, int const stream) const {
+        std::uint64_t const key = mix(mix(mix(_seed + static_cast<std::uint32_t>(x)) +
+                                          static_cast<std::uint32_t>(y)) +
+                                      static_cast<std::uint32_t>(stream));
+        double const u1 = ((mix(key) >> 11) + 0.5) / 9007199254740992.0;  // in (0, 1); 2^53
+        double const u2 = (mix(key + 1) >> 11) / 9007199254740992.0;       // in [0, 1)
+        // Box-Muller
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(geom::TWOPI * u2);
+    }
+
+private:
+    // The splitmix64 finaliser
+    static std::uint64_t mix(std::uint64_t z) {
+        z += 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t _seed;
+};
+
+/************************************************************************************************************/
+/*
+ * Calculate the values to use to interpolate over a CR's pixels
+ *
+ * The estimates only read the image, so many Footprints may be processed at once; removeCR writes the
+ * values back once they've all been calculated.
  */
 template <typename MaskedImageT>
 class RemoveCR {
 public:
-    RemoveCR(MaskedImageT const &mimage, double const bkgd, typename MaskedImageT::Mask::Pixel badMask,
-             bool const debias, afw::math::Random &rand)
+    typedef typename MaskedImageT::Image::Pixel ImagePixel;
+    typedef typename MaskedImageT::Mask::Pixel MaskPixel;
+    typedef typename MaskedImageT::Variance::Pixel VariancePixel;
+
+    RemoveCR(MaskedImageT const &mimage, double const bkgd, MaskPixel const crBit, MaskPixel const badMask,
+             bool const debias, CounterGaussian const &rand)
             : _image(mimage),
               _bkgd(bkgd),
+              _x0(mimage.getX0()),
+              _y0(mimage.getY0()),
               _ncol(mimage.getWidth()),
               _nrow(mimage.getHeight()),
-              _badMask(badMask),
+              _interpMask(badMask | crBit),
               _debias(debias),
-              _rand(rand) {}
-
-    void operator()(geom::Point2I const &point, int) {
-        int const &x = point.getX();
-        int const &y = point.getY();
-        typename MaskedImageT::xy_locator loc = _image.xy_at(x - _image.getX0(), y - _image.getY0());
-        typedef typename MaskedImageT::Image::Pixel MImagePixel;
-        MImagePixel min = std::numeric_limits<MImagePixel>::max();
+              _rand(rand),
+              _imageRows(_nrow),
+              _maskRows(_nrow),
+              _varianceRows(_nrow) {
+        auto const imageArray = mimage.getImage()->getArray();
+        auto const maskArray = mimage.getMask()->getArray();
+        auto const varianceArray = mimage.getVariance()->getArray();
+        for (int y = 0; y < _nrow; ++y) {
+            _imageRows[y] = imageArray.getData() + y * imageArray.getStrides()[0];
+            _maskRows[y] = maskArray.getData() + y * maskArray.getStrides()[0];
+            _varianceRows[y] = varianceArray.getData() + y * varianceArray.getStrides()[0];
+        }
+    }
+    /*
+     * Return the value to use for the pixel at (x, y) (in the image's parent coordinates)
+     */
+    ImagePixel operator()(int const x, int const y) const {
+        int const ix = x - _x0;  // position in the image's pixel coordinates
+        int const iy = y - _y0;
+        ImagePixel min = std::numeric_limits<ImagePixel>::max();
         int ngood = 0;  // number of good values on min
 
-        MImagePixel const minval =
-                _bkgd - 2 * sqrt(loc.variance());  // min. acceptable pixel value after interp
-                                                   /*
-                                                    * W-E row
-                                                    */
-        if (x - 2 >= 0 && x + 2 < _ncol) {
-            if ((loc.mask(-2, 0) | _badMask) || (loc.mask(-1, 0) | _badMask) || (loc.mask(1, 0) | _badMask) ||
-                (loc.mask(2, 0) | _badMask)) {
-                ;  // estimate is contaminated
-            } else {
-                MImagePixel const v_m2 = loc.image(-2, 0);
-                MImagePixel const v_m1 = loc.image(-1, 0);
-                MImagePixel const v_p1 = loc.image(1, 0);
-                MImagePixel const v_p2 = loc.image(2, 0);
-
-                MImagePixel const tmp = interp::lpc_1_c1 * (v_m1 + v_p1) + interp::lpc_1_c2 * (v_m2 + v_p2);
-
-                if (tmp > minval && tmp < min) {
-                    min = tmp;
-                    ngood++;
-                }
-            }
-        }
+        double const sigma = sqrt(_varianceRows[iy][ix]);
+        ImagePixel const minval = _bkgd - 2 * sigma;  // min. acceptable pixel value after interp
         /*
-         * N-S column
+         * W-E row
          */
-        if (y - 2 >= 0 && y + 2 < _nrow) {
-            if ((loc.mask(0, -2) | _badMask) || (loc.mask(0, -1) | _badMask) || (loc.mask(0, 1) | _badMask) ||
-                (loc.mask(0, 2) | _badMask)) {
-                ; /* estimate is contaminated */
-            } else {
-                MImagePixel const v_m2 = loc.image(0, -2);
-                MImagePixel const v_m1 = loc.image(0, -1);
-                MImagePixel const v_p1 = loc.image(0, 1);
-                MImagePixel const v_p2 = loc.image(0, 2);
-
-                MImagePixel const tmp = interp::lpc_1_c1 * (v_m1 + v_p1) + interp::lpc_1_c2 * (v_m2 + v_p2);
-
-                if (tmp > minval && tmp < min) {
-                    min = tmp;
-                    ngood++;
-                }
-            }
+        if (ix - 2 >= 0 && ix + 2 < _ncol) {
+            estimate(&min, &ngood, minval, ix, iy, 1, 0, interp::lpc_1_c1, interp::lpc_1_c2);
         }
         /*
-         * SW--NE diagonal
+         * N-S column
          */
-        if (x - 2 >= 0 && x + 2 < _ncol && y - 2 >= 0 && y + 2 < _nrow) {
-            if ((loc.mask(-2, -2) | _badMask) || (loc.mask(-1, -1) | _badMask) ||
-                (loc.mask(1, 1) | _badMask) || (loc.mask(2, 2) | _badMask)) {
-                ; /* estimate is contaminated */
-            } else {
-                MImagePixel const v_m2 = loc.image(-2, -2);
-                MImagePixel const v_m1 = loc.image(-1, -1);
-                MImagePixel const v_p1 = loc.image(1, 1);
-                MImagePixel const v_p2 = loc.image(2, 2);
-
-                MImagePixel const tmp =
-                        interp::lpc_1s2_c1 * (v_m1 + v_p1) + interp::lpc_1s2_c2 * (v_m2 + v_p2);
-
-                if (tmp > minval && tmp < min) {
-                    min = tmp;
-                    ngood++;
-                }
-            }
+        if (iy - 2 >= 0 && iy + 2 < _nrow) {
+            estimate(&min, &ngood, minval, ix, iy, 0, 1, interp::lpc_1_c1, interp::lpc_1_c2);
         }
-        /*
-         * SE--NW diagonal
-         */
-        if (x - 2 >= 0 && x + 2 < _ncol && y - 2 >= 0 && y + 2 < _nrow) {
-            if ((loc.mask(2, -2) | _badMask) || (loc.mask(1, -1) | _badMask) ||
-                (loc.mask(-1, 1) | _badMask) || (loc.mask(-2, 2) | _badMask)) {
-                ; /* estimate is contaminated */
-            } else {
-                MImagePixel const v_m2 = loc.image(2, -2);
-                MImagePixel const v_m1 = loc.image(1, -1);
-                MImagePixel const v_p1 = loc.image(-1, 1);
-                MImagePixel const v_p2 = loc.image(-2, 2);
-
-                MImagePixel const tmp =
-                        interp::lpc_1s2_c1 * (v_m1 + v_p1) + interp::lpc_1s2_c2 * (v_m2 + v_p2);
-
-                if (tmp > minval && tmp < min) {
-                    min = tmp;
-                    ngood++;
-                }
-            }
+        if (ix - 2 >= 0 && ix + 2 < _ncol && iy - 2 >= 0 && iy + 2 < _nrow) {
+            /*
+             * SW--NE diagonal
+             */
+            estimate(&min, &ngood, minval, ix, iy, 1, 1, interp::lpc_1s2_c1, interp::lpc_1s2_c2);
+            /*
+             * SE--NW diagonal
+             */
+            estimate(&min, &ngood, minval, ix, iy, -1, 1, interp::lpc_1s2_c1, interp::lpc_1s2_c2);
         }
         /*
          * Have we altogether failed to find an acceptable value? If so interpolate
@@ -894,17 +1736,19 @@ public:
          * both directions fail, use the background value.
          */
         if (ngood == 0) {
-            std::pair<bool, MImagePixel const> val_h = interp::singlePixel(x, y, _image, true, minval);
-            std::pair<bool, MImagePixel const> val_v = interp::singlePixel(x, y, _image, false, minval);
+            std::pair<bool, ImagePixel const> val_h =
+                    interp::singlePixel(x, y, _image, true, minval, _interpMask);
+            std::pair<bool, ImagePixel const> val_v =
+                    interp::singlePixel(x, y, _image, false, minval, _interpMask);
 
             if (!val_h.first) {
                 if (!val_v.first) {  // Still no good value. Guess wildly
-                    min = _bkgd + sqrt(loc.variance()) * _rand.gaussian();
+                    min = _bkgd + sigma * _rand(x, y, 0);
                 } else {
                     min = val_v.second;
                 }
             } else {
-                if (val_v.first) {
+                if (!val_v.first) {
                     min = val_h.second;
                 } else {
                     min = (val_v.second + val_h.second) / 2;
@@ -924,19 +1768,47 @@ public:
         }
 
         if (_debias && ngood > 1) {
-            min -= interp::min2GaussianBias * sqrt(loc.variance()) * _rand.gaussian();
+            min -= interp::min2GaussianBias * sigma * _rand(x, y, 1);
         }
 
-        loc.image() = min;
+        return min;
     }
 
 private:
+    /*
+     * Estimate the pixel at (x, y) from the pixels 1 and 2 steps of (dx, dy) away on either side,
+     * updating *min and *ngood if the estimate's acceptable
+     */
+    void estimate(ImagePixel *min, int *ngood, ImagePixel const minval, int const x, int const y,
+                  int const dx, int const dy, double const c1, double const c2) const {
+        if ((_maskRows[y - 2 * dy][x - 2 * dx] & _interpMask) || (_maskRows[y - dy][x - dx] & _interpMask) ||
+            (_maskRows[y + dy][x + dx] & _interpMask) ||
+            (_maskRows[y + 2 * dy][x + 2 * dx] & _interpMask)) {
+            return;  // estimate is contaminated by bad pixels or other CRs
+        }
+        ImagePixel const v_m2 = _imageRows[y - 2 * dy][x - 2 * dx];
+        ImagePixel const v_m1 = _imageRows[y - dy][x - dx];
+        ImagePixel const v_p1 = _imageRows[y + dy][x + dx];
+        ImagePixel const v_p2 = _imageRows[y + 2 * dy][x + 2 * dx];
+
+        ImagePixel const tmp = c1 * (v_m1 + v_p1) + c2 * (v_m2 + v_p2);
+
+        if (tmp > minval && tmp < *min) {
+            *min = tmp;
+            ++*ngood;
+        }
+    }
+
     MaskedImageT const &_image;
     double _bkgd;
+    int _x0, _y0;
     int _ncol, _nrow;
-    typename MaskedImageT::Mask::Pixel _badMask;
+    MaskPixel _interpMask;  // pixels that mustn't be used in estimates; bad pixels and CRs
     bool _debias;
-    afw::math::Random &_rand;
+    CounterGaussian const &_rand;
+    std::vector<ImagePixel const *> _imageRows;  // pointers to the start of each row of the image
+    std::vector<MaskPixel const *> _maskRows;    //                                       mask
+    std::vector<VariancePixel const *> _varianceRows;  //                                 variance
 };
 
 /************************************************************************************************************/
@@ -947,13 +1819,14 @@ template <typename ImageT, typename MaskT>
 void removeCR(afw::image::MaskedImage<ImageT, MaskT> &mi,                    // image to search
               std::vector<std::shared_ptr<afw::detection::Footprint>> &CRs,  // list of cosmic rays
               double const bkgd,                                             // non-subtracted background
-              MaskT const,                                                   // Bit value used to label CRs
+              MaskT const crBit,                                             // Bit value used to label CRs
               MaskT const saturBit,  // Bit value used to label saturated pixels
               MaskT const badMask,   // Bit mask for bad pixels
               bool const debias,     // statistically debias values?
-              bool const grow        // Grow CRs?
+              bool const grow,       // Grow CRs?
+              int const nThreads     // number of threads to use
 ) {
-    afw::math::Random rand;  // a random number generator
+    CounterGaussian const rand(grow ? 1 : 0);  // a random number generator; different for each pass
     /*
      * replace the values of cosmic-ray contaminated pixels with 1-dim 2nd-order weighted means Cosmic-ray
      * contaminated pixels have already been given a mask value, crBit
@@ -964,12 +1837,21 @@ void removeCR(afw::image::MaskedImage<ImageT, MaskT> &mi,                    //
      * XXX SDSS (and we) go through this list backwards; why?
      */
 
-    // a functor to remove a CR
-    RemoveCR<afw::image::MaskedImage<ImageT, MaskT>> removeCR(mi, bkgd, badMask, debias, rand);
+    // a functor to calculate the values for a CR's pixels
+    RemoveCR<afw::image::MaskedImage<ImageT, MaskT>> const removeCR(mi, bkgd, crBit, badMask, debias, rand);
+    /*
+     * Calculate all the values before writing any of them back, so the values don't depend on the order
+     * in which the CRs are processed; each CR's values are stored starting at values[offsets[i]]
+     */
+    int const ncr = CRs.size();
+    std::vector<std::size_t> offsets(ncr + 1, 0);
+    for (int i = 0; i < ncr; ++i) {
+        offsets[i + 1] = offsets[i] + CRs[i]->getSpans()->getArea();
+    }
+    std::vector<ImageT> values(offsets[ncr]);
 
-    for (std::vector<std::shared_ptr<afw::detection::Footprint>>::reverse_iterator fiter = CRs.rbegin();
-         fiter != CRs.rend(); ++fiter) {
-        std::shared_ptr<afw::detection::Footprint> cr = *fiter;
+    detail::parallelFor(ncr, nThreads, [&](int i) {
+        std::shared_ptr<afw::detection::Footprint> cr = CRs[i];
         /*
          * If I grow this CR does it touch saturated pixels?  If so, don't
          * interpolate and add CR pixels to saturated mask
@@ -996,10 +1878,29 @@ void removeCR(afw::image::MaskedImage<ImageT, MaskT> &mi,                    //
         /*
          * OK, fix it
          */
-        // applyFunctor must have an argument other than the functor, however in this case
-        // additional arguments are unneeded, so pass a constant 1 to be iterated over
-        // and ignore
-        cr->getSpans()->applyFunctor(removeCR, 1);
+        ImageT *value = &values[offsets[i]];
+        for (auto const &span : *cr->getSpans()) {
+            int const y = span.getY();
+            for (int x = span.getX0(); x <= span.getX1(); ++x) {
+                *value++ = removeCR(x, y);
+            }
+        }
+    });
+    /*
+     * Write the new values into the image
+     */
+    int const x0 = mi.getX0();
+    int const y0 = mi.getY0();
+    auto const imageArray = mi.getImage()->getArray();
+    std::ptrdiff_t const stride = imageArray.getStrides()[0];
+    for (int i = 0; i < ncr; ++i) {
+        ImageT const *value = &values[offsets[i]];
+        for (auto const &span : *CRs[i]->getSpans()) {
+            ImageT *row = imageArray.getData() + (span.getY() - y0) * stride;
+            for (int x = span.getX0(); x <= span.getX1(); ++x) {
+                row[x - x0] = *value++;
+            }
+        }
     }
 }
 }  // namespace
@@ -1011,7 +1912,24 @@ void removeCR(afw::image::MaskedImage<ImageT, MaskT> &mi,                    //
 #define INSTANTIATE(TYPE)                                                                            \
     template std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRays(                 \
             afw::image::MaskedImage<TYPE> &image, afw::detection::Psf const &psf, double const bkgd, \
-            pex::policy::Policy const &policy, bool const keep)
+            pex::policy::Policy const &policy, bool const keep, CosmicRayStatistics *stats);       \
+    template std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRaysTiled(            \
+            geom::Box2I const &bbox,                                                                 \
+            std::function<std::shared_ptr<afw::image::MaskedImage<TYPE>>(geom::Box2I const &)> const \
+                    &readTile,                                                                       \
+            std::function<void(afw::image::MaskedImage<TYPE> const &, geom::Box2I const &)> const    \
+                    &writeTile,                                                                      \
+            afw::detection::Psf const &psf, double const bkgd, pex::policy::Policy const &policy,    \
+            int const tileWidth, int const tileHeight, int const overlap, bool const keep);          \
+    template std::vector<std::shared_ptr<afw::detection::Footprint>> findCosmicRaysTiled(            \
+            afw::image::MaskedImage<TYPE> &image, afw::detection::Psf const &psf, double const bkgd, \
+            pex::policy::Policy const &policy, int const tileWidth, int const tileHeight,            \
+            int const overlap, bool const keep);                                                     \
+    template std::vector<std::vector<std::shared_ptr<afw::detection::Footprint>>> findCosmicRaysBatch( \
+            std::vector<std::shared_ptr<afw::image::MaskedImage<TYPE>>> const &images,               \
+            std::vector<std::shared_ptr<afw::detection::Psf const>> const &psfs,                     \
+            std::vector<double> const &bkgds, pex::policy::Policy const &policy, int const nThreads,  \
+            bool const keep)
 
 INSTANTIATE(float);
 INSTANTIATE(double);  // Why do we need double images?
@@ -26,10 +26,17 @@
  * Represent a PSF as for a Coadd based on the James Jee stacking
  * algorithm which was extracted from Stackfit.
  */
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <set>
+#include <tuple>
 #include "boost/iterator/iterator_adaptor.hpp"
 #include "boost/iterator/transform_iterator.hpp"
 #include "ndarray/eigen.h"
@@ -44,6 +51,7 @@
 #include "lsst/afw/table/io/CatalogVector.h"
 #include "lsst/afw/table/io/Persistable.cc"
 #include "lsst/meas/algorithms/WarpedPsf.h"
+#include "lsst/meas/algorithms/detail/Parallel.h"
 
 namespace lsst {
 namespace afw {
@@ -136,8 +144,414 @@ geom::Point2D computeAveragePosition(afw::table::ExposureCatalog const &catalog,
     return result.getPoint();
 }
 
+int const nPointPerEdge = 16;   // number of points to transform along each edge of an input's region
+int const maxCellPerSide = 64;  // maximum number of cells along each side of the InputIndex's grid
+std::size_t const maxBatchSize = 256;  // most positions that computeKernelImages computes together
+
 }  // namespace
 
+// ---------- Cache of the inputs' components ---------------------------------------------------------------
+
+/*
+ * The transform from each input's pixels to the coadd's, and its inverse
+ *
+ * These only depend on the catalog, which can't change, but are expensive to make, so they're made
+ * when they're first needed and kept.  Any number of threads may use the cache at once.  Transforms
+ * are made outside the lock, so threads making different inputs' transforms don't wait for each other;
+ * if two threads make the same one at once, they're identical and the first to finish is kept.
+ *
+ * The WarpedPsfs that use the transforms are cheap to make, and each has its own cache of kernel
+ * images, so they're made afresh for each use rather than kept.
+ */
+class CoaddPsf::ComponentCache {
+public:
+    explicit ComponentCache(std::size_t nInput) : _transforms(nInput), _inverseTransforms(nInput) {}
+
+    // Return the transform from the pixels of input i (whose record is given) to the coadd's pixels
+    std::shared_ptr<afw::geom::TransformPoint2ToPoint2 const> getTransform(
+            std::size_t i, afw::table::ExposureRecord const &record, afw::geom::SkyWcs const &coaddWcs) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_transforms[i]) {
+                return _transforms[i];
+            }
+        }
+        std::shared_ptr<afw::geom::TransformPoint2ToPoint2 const> transform =
+                afw::geom::makeWcsPairTransform(*record.getWcs(), coaddWcs);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_transforms[i]) {
+            _transforms[i] = transform;
+        }
+        return _transforms[i];
+    }
+
+    // Return a new WarpedPsf of input i (whose record is given) on the coadd
+    std::shared_ptr<WarpedPsf const> makeWarpedPsf(
+            std::size_t i, afw::table::ExposureRecord const &record, afw::geom::SkyWcs const &coaddWcs,
+            CONST_PTR(afw::math::WarpingControl) const &warpingControl) {
+        auto const transform = getTransform(i, record, coaddWcs);
+        std::shared_ptr<afw::geom::TransformPoint2ToPoint2 const> inverse;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            inverse = _inverseTransforms[i];
+        }
+        if (!inverse) {
+            inverse = transform->inverted();
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_inverseTransforms[i]) {
+                _inverseTransforms[i] = inverse;
+            }
+            inverse = _inverseTransforms[i];
+        }
+        return std::make_shared<WarpedPsf const>(record.getPsf(), transform, inverse, warpingControl);
+    }
+
+private:
+    mutable std::mutex _mutex;  // protects the contents of the vectors, which never change size
+    std::vector<std::shared_ptr<afw::geom::TransformPoint2ToPoint2 const>> _transforms;
+    std::vector<std::shared_ptr<afw::geom::TransformPoint2ToPoint2 const>> _inverseTransforms;
+};
+
+// ---------- Spatial index of the inputs --------------------------------------------------------------------
+
+/*
+ * A coarse grid in coadd pixel coordinates, listing the inputs that may contain the points in each cell
+ *
+ * Each input's region (its bounding box, clipped to the bounding box of its valid polygon if it has one)
+ * is mapped to the coadd by transforming points around its boundary.  The bounding box of the result,
+ * padded to allow for the boundary curving between the points, is entered in every cell it touches.
+ * Queries return candidates that must still be checked with ExposureRecord::contains, so the grid need
+ * only be conservative; inputs whose regions can't be mapped reliably are candidates everywhere.
+ */
+class CoaddPsf::InputIndex {
+public:
+    InputIndex(afw::table::ExposureCatalog const &catalog, afw::geom::SkyWcs const &coaddWcs,
+               ComponentCache &components);
+
+    // Return the indices of the inputs that may contain a point in the coadd, in increasing order
+    std::vector<std::size_t> getCandidates(geom::Point2D const &position) const;
+
+private:
+    // Return the bounding box in the coadd of an input's region; empty if it can't be mapped reliably
+    static geom::Box2D mapToCoadd(afw::table::ExposureRecord const &record,
+                                  afw::geom::TransformPoint2ToPoint2 const &exposureToCoadd);
+
+    geom::Box2D _bbox;                              // area of the coadd covered by the grid
+    int _nx, _ny;                                   // number of cells in x and y
+    double _cellWidth, _cellHeight;                 // size of each cell
+    std::vector<std::vector<std::size_t>> _cells;   // candidates for each cell, cells ordered by row
+    std::vector<std::size_t> _unmapped;             // inputs that are candidates everywhere
+};
+
+geom::Box2D CoaddPsf::InputIndex::mapToCoadd(afw::table::ExposureRecord const &record,
+                                             afw::geom::TransformPoint2ToPoint2 const &exposureToCoadd) {
+    geom::Box2D region(record.getBBox());
+    if (record.getValidPolygon()) {
+        region.clip(record.getValidPolygon()->getBBox());
+    }
+    if (region.isEmpty()) {
+        return geom::Box2D();
+    }
+
+    std::vector<geom::Point2D> boundary;
+    boundary.reserve(4 * nPointPerEdge);
+    geom::Extent2D const step = region.getDimensions() / nPointPerEdge;
+    for (int i = 0; i < nPointPerEdge; ++i) {
+        boundary.emplace_back(region.getMinX() + i * step.getX(), region.getMinY());
+        boundary.emplace_back(region.getMaxX(), region.getMinY() + i * step.getY());
+        boundary.emplace_back(region.getMaxX() - i * step.getX(), region.getMaxY());
+        boundary.emplace_back(region.getMinX(), region.getMaxY() - i * step.getY());
+    }
+
+    std::vector<geom::Point2D> mapped;
+    try {
+        mapped = exposureToCoadd.applyForward(boundary);
+        // Reject regions that the projections fold or tear (e.g. inputs with bad astrometry), as
+        // the transformed boundary needn't enclose the region
+        std::vector<geom::Point2D> const roundTrip = exposureToCoadd.applyInverse(mapped);
+        for (std::size_t i = 0; i < boundary.size(); ++i) {
+            if (!(std::abs(roundTrip[i].getX() - boundary[i].getX()) < 1.0 &&
+                  std::abs(roundTrip[i].getY() - boundary[i].getY()) < 1.0)) {
+                return geom::Box2D();
+            }
+        }
+    } catch (std::exception &) {
+        return geom::Box2D();
+    }
+
+    geom::Box2D bbox;
+    for (auto const &point : mapped) {
+        bbox.include(point);
+    }
+    // allow for the boundary curving between the points we transformed
+    bbox.grow(2.0 + 0.01 * std::max(bbox.getWidth(), bbox.getHeight()));
+
+    return bbox;
+}
+
+CoaddPsf::InputIndex::InputIndex(afw::table::ExposureCatalog const &catalog,
+                                 afw::geom::SkyWcs const &coaddWcs, ComponentCache &components)
+        : _bbox(), _nx(0), _ny(0), _cellWidth(0.0), _cellHeight(0.0), _cells(), _unmapped() {
+    std::vector<geom::Box2D> regions;
+    regions.reserve(catalog.size());
+    for (std::size_t i = 0; i < catalog.size(); ++i) {
+        geom::Box2D region;
+        if (catalog[i].getWcs()) {
+            try {
+                region = mapToCoadd(catalog[i], *components.getTransform(i, catalog[i], coaddWcs));
+            } catch (std::exception &) {
+            }
+        }
+        regions.push_back(region);
+        if (regions.back().isEmpty()) {
+            _unmapped.push_back(i);
+        } else {
+            _bbox.include(regions.back());
+        }
+    }
+    if (_bbox.isEmpty()) {
+        return;
+    }
+
+    int const nCellPerSide = std::min(
+            maxCellPerSide, std::max(1, static_cast<int>(std::ceil(2 * std::sqrt(catalog.size())))));
+    _nx = _ny = nCellPerSide;
+    _cellWidth = _bbox.getWidth() / _nx;
+    _cellHeight = _bbox.getHeight() / _ny;
+    _cells.resize(_nx * _ny);
+    for (std::size_t i = 0; i < regions.size(); ++i) {
+        if (regions[i].isEmpty()) {
+            continue;
+        }
+        int const ix0 = std::max(0, static_cast<int>((regions[i].getMinX() - _bbox.getMinX()) / _cellWidth));
+        int const ix1 = std::min(_nx - 1,
+                                 static_cast<int>((regions[i].getMaxX() - _bbox.getMinX()) / _cellWidth));
+        int const iy0 = std::max(0,
+                                 static_cast<int>((regions[i].getMinY() - _bbox.getMinY()) / _cellHeight));
+        int const iy1 = std::min(_ny - 1,
+                                 static_cast<int>((regions[i].getMaxY() - _bbox.getMinY()) / _cellHeight));
+        for (int iy = iy0; iy <= iy1; ++iy) {
+            for (int ix = ix0; ix <= ix1; ++ix) {
+                _cells[iy * _nx + ix].push_back(i);
+            }
+        }
+    }
+}
+
+std::vector<std::size_t> CoaddPsf::InputIndex::getCandidates(geom::Point2D const &position) const {
+    if (!_bbox.contains(position)) {
+        return _unmapped;
+    }
+    int const ix = std::min(_nx - 1, static_cast<int>((position.getX() - _bbox.getMinX()) / _cellWidth));
+    int const iy = std::min(_ny - 1, static_cast<int>((position.getY() - _bbox.getMinY()) / _cellHeight));
+    std::vector<std::size_t> const &cell = _cells[iy * _nx + ix];
+
+    std::vector<std::size_t> candidates;
+    candidates.reserve(cell.size() + _unmapped.size());
+    std::merge(cell.begin(), cell.end(), _unmapped.begin(), _unmapped.end(), std::back_inserter(candidates));
+    return candidates;
+}
+
+// ---------- Cache of kernel images ------------------------------------------------------------------------
+
+/*
+ * A least-recently-used cache of kernel images, keyed on a cell in the coadd and the inputs used
+ *
+ * See CoaddPsf::setKernelImageCache.  Any number of threads may use the cache at once; images are
+ * computed outside the lock.
+ */
+class CoaddPsf::KernelImageCache {
+public:
+    typedef afw::detection::Psf::Image Image;
+
+    KernelImageCache(double cellSize, std::size_t maxMemory) : _cellSize(cellSize), _maxMemory(maxMemory) {}
+
+    double getCellSize() const { return _cellSize; }
+    std::size_t getMaxMemory() const { return _maxMemory; }
+
+    // Return the centre of the cell containing a position
+    geom::Point2D getCellCenter(geom::Point2D const &position) const {
+        return geom::Point2D((std::floor(position.getX() / _cellSize) + 0.5) * _cellSize,
+                             (std::floor(position.getY() / _cellSize) + 0.5) * _cellSize);
+    }
+
+    /*
+     * Return a copy of the image for the cell containing position and these inputs, calling
+     * compute(centre of cell) to make it if it isn't in the cache
+     */
+    template <typename ComputeT>
+    PTR(Image) get(geom::Point2D const &position, std::vector<std::size_t> const &inputs,
+                   ComputeT const &compute);
+
+    CoaddPsfCacheStatistics getStatistics() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+private:
+    struct Key {
+        long ix, iy;                      // cell
+        std::vector<std::size_t> inputs;  // indices of inputs used
+
+        bool operator<(Key const &other) const {
+            return std::tie(ix, iy, inputs) < std::tie(other.ix, other.iy, other.inputs);
+        }
+    };
+    typedef std::list<std::pair<Key, PTR(Image const)>> EntryList;
+
+    // Return the memory used by an entry
+    static std::size_t getMemory(Key const &key, Image const &image) {
+        return image.getWidth() * image.getHeight() * sizeof(Image::Pixel) +
+               key.inputs.size() * sizeof(std::size_t);
+    }
+
+    double const _cellSize;
+    std::size_t const _maxMemory;
+    mutable std::mutex _mutex;  // protects everything below
+    EntryList _entries;         // most recently used first
+    std::map<Key, EntryList::iterator> _index;
+    CoaddPsfCacheStatistics _stats;
+};
+
+template <typename ComputeT>
+PTR(CoaddPsf::KernelImageCache::Image)
+CoaddPsf::KernelImageCache::get(geom::Point2D const &position, std::vector<std::size_t> const &inputs,
+                                ComputeT const &compute) {
+    Key key{static_cast<long>(std::floor(position.getX() / _cellSize)),
+            static_cast<long>(std::floor(position.getY() / _cellSize)), inputs};
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto const found = _index.find(key);
+        if (found != _index.end()) {
+            _entries.splice(_entries.begin(), _entries, found->second);
+            ++_stats.nHit;
+            return std::make_shared<Image>(*found->second->second, true);
+        }
+    }
+
+    PTR(Image const) image = compute(getCellCenter(position));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_stats.nMiss;
+    if (_index.find(key) == _index.end()) {  // another thread may have added it meanwhile
+        _stats.memory += getMemory(key, *image);
+        _entries.emplace_front(key, image);
+        _index.emplace(std::move(key), _entries.begin());
+        ++_stats.nEntry;
+        while (_stats.memory > _maxMemory && !_entries.empty()) {
+            _stats.memory -= getMemory(_entries.back().first, *_entries.back().second);
+            _index.erase(_entries.back().first);
+            _entries.pop_back();
+            --_stats.nEntry;
+            ++_stats.nEvicted;
+        }
+    }
+    return std::make_shared<Image>(*image, true);
+}
+
+void CoaddPsf::setKernelImageCache(double cellSize, double maxMemory) {
+    if (maxMemory <= 0) {
+        _kernelImageCache.reset();
+        return;
+    }
+    if (!(cellSize > 0)) {
+        throw LSST_EXCEPT(
+                pex::exceptions::InvalidParameterError,
+                (boost::format("Kernel image cache's cell size must be positive, not %g") % cellSize).str());
+    }
+    _kernelImageCache =
+            std::make_shared<KernelImageCache>(cellSize, static_cast<std::size_t>(maxMemory * 1024 * 1024));
+}
+
+CoaddPsfCacheStatistics CoaddPsf::getKernelImageCacheStatistics() const {
+    return _kernelImageCache ? _kernelImageCache->getStatistics() : CoaddPsfCacheStatistics();
+}
+
+// ---------- Parallel warping -------------------------------------------------------------------------------
+
+/*
+ * A pool of WarpingControls, so that threads warping at the same time don't share a warping kernel
+ */
+class CoaddPsf::WarpingControlPool {
+public:
+    WarpingControlPool(std::string const &warpingKernelName, int cacheSize)
+            : _warpingKernelName(warpingKernelName), _cacheSize(cacheSize) {}
+
+    // A WarpingControl reserved for its holder until the Lease is destroyed
+    class Lease {
+    public:
+        explicit Lease(WarpingControlPool &pool) : _pool(pool), _control(pool.acquire()) {}
+        ~Lease() { _pool.release(_control); }
+
+        Lease(Lease const &) = delete;
+        Lease &operator=(Lease const &) = delete;
+
+        CONST_PTR(afw::math::WarpingControl) const &get() const { return _control; }
+
+    private:
+        WarpingControlPool &_pool;
+        CONST_PTR(afw::math::WarpingControl) _control;
+    };
+
+private:
+    CONST_PTR(afw::math::WarpingControl) acquire() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_free.empty()) {
+                auto control = _free.back();
+                _free.pop_back();
+                return control;
+            }
+        }
+        return std::make_shared<afw::math::WarpingControl const>(_warpingKernelName, "", _cacheSize);
+    }
+
+    void release(CONST_PTR(afw::math::WarpingControl) const &control) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(control);
+    }
+
+    std::string const _warpingKernelName;
+    int const _cacheSize;
+    std::mutex _mutex;                                         // protects _free
+    std::vector<CONST_PTR(afw::math::WarpingControl)> _free;  // controls that nobody is using
+};
+
+void CoaddPsf::setNumThreads(int nThreads) {
+    _nThreads = nThreads;
+    if (nThreads == 1) {
+        _inputsSharePsfs = false;
+        _threadPool.reset();
+        return;
+    }
+    std::set<afw::detection::Psf const *> psfs;
+    _inputsSharePsfs = false;
+    for (auto const &record : _catalog) {
+        if (!psfs.insert(record.getPsf().get()).second) {
+            _inputsSharePsfs = true;
+            break;
+        }
+    }
+    if (!_warpingControlPool) {
+        _warpingControlPool =
+                std::make_shared<WarpingControlPool>(_warpingKernelName, _warpingControl->getCacheSize());
+    }
+    // The threads are started once here, rather than for every kernel image
+    if (!_threadPool || _threadPool->getThreadCount() != detail::getThreadCount(nThreads)) {
+        _threadPool = std::make_shared<detail::ThreadPool>(nThreads);
+    }
+}
+
+std::vector<std::size_t> CoaddPsf::_getInputsContaining(geom::Point2D const &ccdXY) const {
+    // Equivalent to _catalog.subsetContaining(ccdXY, _coaddWcs, true), but only checking the candidates
+    lsst::geom::SpherePoint const coord = _coaddWcs.pixelToSky(ccdXY);
+    std::vector<std::size_t> inputs = _inputIndex->getCandidates(ccdXY);
+    inputs.erase(std::remove_if(inputs.begin(), inputs.end(),
+                                [this, &coord](std::size_t i) { return !_catalog[i].contains(coord, true); }),
+                 inputs.end());
+    return inputs;
+}
+
 CoaddPsf::CoaddPsf(afw::table::ExposureCatalog const &catalog, afw::geom::SkyWcs const &coaddWcs,
                    std::string const &weightFieldName, std::string const &warpingKernelName, int cacheSize)
         : _coaddWcs(coaddWcs),
@@ -164,10 +578,19 @@ CoaddPsf::CoaddPsf(afw::table::ExposureCatalog const &catalog, afw::geom::SkyWcs
         record->assign(*i, mapper);
         _catalog.push_back(record);
     }
+    _components = std::make_shared<ComponentCache>(_catalog.size());
+    _inputIndex = std::make_shared<InputIndex const>(_catalog, _coaddWcs, *_components);
     _averagePosition = computeAveragePosition(_catalog, _coaddWcs, _weightKey);
 }
 
-PTR(afw::detection::Psf) CoaddPsf::clone() const { return std::make_shared<CoaddPsf>(*this); }
+PTR(afw::detection::Psf) CoaddPsf::clone() const {
+    auto psf = std::make_shared<CoaddPsf>(*this);
+    if (_kernelImageCache) {
+        psf->_kernelImageCache = std::make_shared<KernelImageCache>(_kernelImageCache->getCellSize(),
+                                                                    _kernelImageCache->getMaxMemory());
+    }
+    return psf;
+}
 
 PTR(afw::detection::Psf) CoaddPsf::resized(int width, int height) const {
     // Not implemented for WarpedPsf
@@ -213,20 +636,23 @@ void addToImage(PTR(afw::image::Image<double>) image,
 }
 
 geom::Box2I CoaddPsf::doComputeBBox(geom::Point2D const &ccdXY, afw::image::Color const &color) const {
-    afw::table::ExposureCatalog subcat = _catalog.subsetContaining(ccdXY, _coaddWcs, true);
-    if (subcat.empty()) {
+    std::vector<std::size_t> const inputs = _getInputsContaining(ccdXY);
+    if (inputs.empty()) {
         throw LSST_EXCEPT(
                 pex::exceptions::InvalidParameterError,
                 (boost::format("Cannot compute BBox at point %s; no input images at that point.") % ccdXY)
                         .str());
     }
 
+    // If we're caching kernel images, they're computed at the centre of each cell
+    geom::Point2D const position = (_kernelImageCache && color.isIndeterminate())
+                                           ? _kernelImageCache->getCellCenter(ccdXY)
+                                           : ccdXY;
     geom::Box2I ret;
-    for (auto const &exposureRecord : subcat) {
-        // compute transform from exposure pixels to coadd pixels
-        auto exposureToCoadd = afw::geom::makeWcsPairTransform(*exposureRecord.getWcs(), _coaddWcs);
-        WarpedPsf warpedPsf = WarpedPsf(exposureRecord.getPsf(), exposureToCoadd, _warpingControl);
-        geom::Box2I componentBBox = warpedPsf.computeBBox(ccdXY, color);
+    for (std::size_t i : inputs) {
+        auto const &exposureRecord = _catalog[i];
+        auto const warpedPsf = _components->makeWarpedPsf(i, exposureRecord, _coaddWcs, _warpingControl);
+        geom::Box2I componentBBox = warpedPsf->computeBBox(position, color);
         ret.include(componentBBox);
     }
 
@@ -236,47 +662,148 @@ geom::Box2I CoaddPsf::doComputeBBox(geom::Point2D const &ccdXY, afw::image::Colo
 PTR(afw::detection::Psf::Image)
 CoaddPsf::doComputeKernelImage(geom::Point2D const &ccdXY, afw::image::Color const &color) const {
     // Get the subset of expoures which contain our coordinate within their validPolygons.
-    afw::table::ExposureCatalog subcat = _catalog.subsetContaining(ccdXY, _coaddWcs, true);
-    if (subcat.empty()) {
+    std::vector<std::size_t> const inputs = _getInputsContaining(ccdXY);
+    if (inputs.empty()) {
         throw LSST_EXCEPT(
                 pex::exceptions::InvalidParameterError,
                 (boost::format("Cannot compute CoaddPsf at point %s; no input images at that point.") % ccdXY)
                         .str());
     }
-    double weightSum = 0.0;
+    return _getKernelImage(ccdXY, color, inputs);
+}
 
-    // Read all the Psf images into a vector.  The code is set up so that this can be done in chunks,
-    // with the image modified to accomodate
-    // However, we currently read all of the images.
-    std::vector<PTR(afw::image::Image<double>)> imgVector;
-    std::vector<double> weightVector;
+PTR(afw::detection::Psf::Image)
+CoaddPsf::_getKernelImage(geom::Point2D const &ccdXY, afw::image::Color const &color,
+                          std::vector<std::size_t> const &inputs) const {
+    if (!_kernelImageCache || !color.isIndeterminate()) {
+        return _computeKernelImage(ccdXY, color, inputs);
+    }
+    return _kernelImageCache->get(ccdXY, inputs, [this, &color, &inputs](geom::Point2D const &position) {
+        return _computeKernelImage(position, color, inputs);
+    });
+}
 
-    for (auto const &exposureRecord : subcat) {
-        // compute transform from exposure pixels to coadd pixels
-        auto exposureToCoadd = afw::geom::makeWcsPairTransform(*exposureRecord.getWcs(), _coaddWcs);
-        PTR(afw::image::Image<double>) componentImg;
+CoaddPsfKernelImageStack CoaddPsf::computeKernelImages(std::vector<geom::Point2D> const &positions,
+                                                       afw::image::Color const &color) const {
+    // Group the positions by their inputs, so that each input's WarpedPsf can be made once per group
+    std::map<std::vector<std::size_t>, std::vector<std::size_t>> groups;  // inputs: indices of positions
+    for (std::size_t k = 0; k < positions.size(); ++k) {
+        std::vector<std::size_t> inputs = _getInputsContaining(positions[k]);
+        if (inputs.empty()) {
+            throw LSST_EXCEPT(
+                    pex::exceptions::InvalidParameterError,
+                    (boost::format("Cannot compute CoaddPsf at point %s; no input images at that point.") %
+                     positions[k])
+                            .str());
+        }
+        groups[std::move(inputs)].push_back(k);
+    }
+
+    std::vector<PTR(afw::detection::Psf::Image)> imgVector(positions.size());
+    for (auto const &group : groups) {
+        std::vector<std::size_t> const &indices = group.second;
+        if (_kernelImageCache && color.isIndeterminate()) {
+            for (std::size_t k : indices) {
+                imgVector[k] = _getKernelImage(positions[k], color, group.first);
+            }
+            continue;
+        }
+        // Batch the positions, so as not to hold every input's image at every position at once
+        for (std::size_t begin = 0; begin < indices.size(); begin += maxBatchSize) {
+            std::size_t const end = std::min(indices.size(), begin + maxBatchSize);
+            std::vector<geom::Point2D> batch;
+            batch.reserve(end - begin);
+            for (std::size_t b = begin; b < end; ++b) {
+                batch.push_back(positions[indices[b]]);
+            }
+            auto const images = _computeKernelImages(batch, color, group.first);
+            for (std::size_t b = begin; b < end; ++b) {
+                imgVector[indices[b]] = images[b - begin];
+            }
+        }
+    }
+
+    CoaddPsfKernelImageStack stack;
+    for (auto const &img : imgVector) {
+        stack.bbox.include(img->getBBox());
+    }
+    stack.images = ndarray::allocate(positions.size(), stack.bbox.getHeight(), stack.bbox.getWidth());
+    stack.images.deep() = 0.0;
+    for (std::size_t k = 0; k < imgVector.size(); ++k) {
+        geom::Box2I const bbox = imgVector[k]->getBBox();
+        int const y0 = bbox.getMinY() - stack.bbox.getMinY();
+        int const x0 = bbox.getMinX() - stack.bbox.getMinX();
+        stack.images[k][ndarray::view(y0, y0 + bbox.getHeight())(x0, x0 + bbox.getWidth())] =
+                imgVector[k]->getArray();
+    }
+    return stack;
+}
+
+PTR(afw::detection::Psf::Image)
+CoaddPsf::_computeKernelImage(geom::Point2D const &ccdXY, afw::image::Color const &color,
+                              std::vector<std::size_t> const &inputs) const {
+    return _computeKernelImages(std::vector<geom::Point2D>(1, ccdXY), color, inputs)[0];
+}
+
+std::vector<PTR(afw::detection::Psf::Image)> CoaddPsf::_computeKernelImages(
+        std::vector<geom::Point2D> const &positions, afw::image::Color const &color,
+        std::vector<std::size_t> const &inputs) const {
+    // Read all the Psf images into a vector for each position.  The code is set up so that this can be
+    // done in chunks, with the image modified to accomodate
+    // However, we currently read all of the images.
+    std::vector<std::vector<PTR(afw::image::Image<double>)>> imgVectors(
+            positions.size(), std::vector<PTR(afw::image::Image<double>)>(inputs.size()));
+    std::vector<double> weightVector(inputs.size());
+
+    bool const parallel = _threadPool && !_inputsSharePsfs;
+    auto warp = [&](int j) {
+        std::size_t const i = inputs[j];
+        auto const &exposureRecord = _catalog[i];
+        // Each input's WarpedPsf is made once, and used at all the positions
+        auto evaluate = [&](WarpedPsf const &warpedPsf) {
+            for (std::size_t k = 0; k < positions.size(); ++k) {
+                imgVectors[k][j] = warpedPsf.computeKernelImage(positions[k], color);
+            }
+        };
         try {
-            WarpedPsf warpedPsf = WarpedPsf(exposureRecord.getPsf(), exposureToCoadd, _warpingControl);
-            componentImg = warpedPsf.computeKernelImage(ccdXY, color);
+            if (!parallel) {
+                evaluate(*_components->makeWarpedPsf(i, exposureRecord, _coaddWcs, _warpingControl));
+            } else {
+                // Warping modifies the WarpingControl's kernel, so each thread needs its own
+                WarpingControlPool::Lease const warpingControl(*_warpingControlPool);
+                evaluate(*_components->makeWarpedPsf(i, exposureRecord, _coaddWcs, warpingControl.get()));
+            }
         } catch (pex::exceptions::RangeError &exc) {
             LSST_EXCEPT_ADD(exc, (boost::format("Computing WarpedPsf kernel image for id=%d") %
                                   exposureRecord.getId())
                                          .str());
             throw exc;
         }
-        imgVector.push_back(componentImg);
-        weightSum += exposureRecord.get(_weightKey);
-        weightVector.push_back(exposureRecord.get(_weightKey));
+        weightVector[j] = exposureRecord.get(_weightKey);
+    };
+    if (parallel) {
+        _threadPool->parallelFor(inputs.size(), warp);
+    } else {
+        for (int j = 0, n = inputs.size(); j < n; ++j) {
+            warp(j);
+        }
     }
-
-    geom::Box2I bbox = getOverallBBox(imgVector);
-
-    // create a zero image of the right size to sum into
-    PTR(afw::detection::Psf::Image) image = std::make_shared<afw::detection::Psf::Image>(bbox);
-    *image = 0.0;
-    addToImage(image, imgVector, weightVector);
-    *image /= weightSum;
-    return image;
+    // Sum in catalog order whatever the number of threads, so that the results don't depend on it
+    double const weightSum = std::accumulate(weightVector.begin(), weightVector.end(), 0.0);
+
+    std::vector<PTR(afw::detection::Psf::Image)> images;
+    images.reserve(positions.size());
+    for (auto const &imgVector : imgVectors) {
+        geom::Box2I bbox = getOverallBBox(imgVector);
+
+        // create a zero image of the right size to sum into
+        PTR(afw::detection::Psf::Image) image = std::make_shared<afw::detection::Psf::Image>(bbox);
+        *image = 0.0;
+        addToImage(image, imgVector, weightVector);
+        *image /= weightSum;
+        images.push_back(image);
+    }
+    return images;
 }
 
 int CoaddPsf::getComponentCount() const { return _catalog.size(); }
@@ -439,7 +966,9 @@ CoaddPsf::CoaddPsf(afw::table::ExposureCatalog const &catalog, afw::geom::SkyWcs
           _weightKey(_catalog.getSchema()["weight"]),
           _averagePosition(averagePosition),
           _warpingKernelName(warpingKernelName),
-          _warpingControl(new afw::math::WarpingControl(warpingKernelName, "", cacheSize)) {}
+          _warpingControl(new afw::math::WarpingControl(warpingKernelName, "", cacheSize)),
+          _components(std::make_shared<ComponentCache>(_catalog.size())),
+          _inputIndex(std::make_shared<InputIndex const>(_catalog, _coaddWcs, *_components)) {}
 
 }  // namespace algorithms
 }  // namespace meas
@@ -32,112 +32,228 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <string>
 #include <typeinfo>
 #include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
 #include "boost/format.hpp"
 
 #include "lsst/afw/geom.h"
 #include "lsst/pex/exceptions.h"
 #include "lsst/afw/image/MaskedImage.h"
+#include "lsst/afw/table/Catalog.h"
+#include "lsst/afw/table/io/CatalogVector.h"
+#include "lsst/afw/table/io/OutputArchive.h"
+#include "lsst/afw/table/io/InputArchive.h"
+#include "lsst/afw/table/io/Persistable.cc"
+#include "lsst/afw/table/aggregates.h"
 #include "lsst/meas/algorithms/Interp.h"
+#include "lsst/meas/algorithms/detail/Parallel.h"
 
 namespace lsst {
+namespace afw {
+namespace table {
+namespace io {
+
+template std::shared_ptr<meas::algorithms::DefectPlan>
+PersistableFacade<meas::algorithms::DefectPlan>::dynamicCast(std::shared_ptr<Persistable> const &);
+
+}  // namespace io
+}  // namespace table
+}  // namespace afw
 namespace meas {
 namespace algorithms {
 
-typedef std::vector<Defect::Ptr>::const_iterator DefectCIter;
-
-/************************************************************************************************************/
+namespace {
 /*
- * Classify an vector of Defect::Ptr for the given row, returning a vector of 1-D
- * Defects (i.e. y0 == y1).  In general we can merge in saturated pixels at
- * this step, although we don't currently do so.
+ * The (clipped) defects that touch the current row, kept sorted by x0
  *
- * See comment above do_defects for a description of how to interpret DefectType
+ * The rows of the image are visited in increasing order (see advance()), and the defects are
+ * sorted by y0 once so that each row only looks at the defects that cover it, rather than at
+ * the whole defect list.
  */
-static std::vector<Defect::Ptr> classify_defects(
-        std::vector<Defect::Ptr> const &badList,  // list of bad things
-        int const y,                              // the row to process
-        int const ncol,                           // number of columns in image
-        int = 0                                   // number of rows in image
-) {
-    std::vector<Defect::Ptr> badList1D;
+class ActiveDefects {
+public:
+    explicit ActiveDefects(std::vector<geom::BoxI> boxes) : _boxes(std::move(boxes)), _next(0) {
+        std::sort(_boxes.begin(), _boxes.end(),
+                  [](geom::BoxI const &a, geom::BoxI const &b) { return a.getMinY() < b.getMinY(); });
+    }
 
-    for (DefectCIter begin = badList.begin(), end = badList.end(), bri = begin; bri != end; ++bri) {
-        Defect::Ptr defect = *bri;
+    /// Update the active set for row y; calls must have non-decreasing y
+    void advance(int const y) {
+        _active.erase(std::remove_if(_active.begin(), _active.end(),
+                                     [y](geom::BoxI const *box) { return box->getMaxY() < y; }),
+                      _active.end());
 
-        if (y < defect->getY0() || y > defect->getY1() || ncol < defect->getX0()) {
-            continue;
+        for (; _next != _boxes.size() && _boxes[_next].getMinY() <= y; ++_next) {
+            geom::BoxI const *box = &_boxes[_next];
+            if (box->getMaxY() < y) {  // never touches a row that we're processing
+                continue;
+            }
+            _active.insert(std::upper_bound(_active.begin(), _active.end(), box,
+                                            [](geom::BoxI const *a, geom::BoxI const *b) {
+                                                return a->getMinX() < b->getMinX();
+                                            }),
+                           box);
+        }
+    }
+
+    /*
+     * Merge the active defects into runs of touching bad pixels, replacing the contents of runs.
+     * In general we can merge in saturated pixels at this step, although we don't currently do so.
+     */
+    void merge(std::vector<DefectRun> &runs) const {
+        runs.clear();
+        for (geom::BoxI const *box : _active) {
+            if (!runs.empty() && runs.back().x1 >= box->getMinX() - 1) {  // touches the previous run
+                runs.back().x1 = std::max(runs.back().x1, box->getMaxX());
+            } else {
+                runs.push_back(DefectRun{box->getMinX(), box->getMaxX(), Defect::MIDDLE, 0});
+            }
         }
+    }
 
-        int const x0 = defect->getX0();
-        int x1 = defect->getX1();
-        //
-        // Look for other defects that touch this one, and push them onto badList1d
-        //
-        for (++bri; bri != end; ++bri) {
-            defect = *bri;
+private:
+    std::vector<geom::BoxI> _boxes;          // all the defects, sorted by y0
+    std::size_t _next;                       // index of first element of _boxes not yet seen
+    std::vector<geom::BoxI const *> _active;  // defects touching the current row, sorted by x0
+};
 
-            if (y < defect->getY0() || y > defect->getY1()) {  // this defect doesn't concern this row
-                continue;
+/*
+ * Copy a row's runs to out, omitting the columns that are interpolated vertically and splitting
+ * runs as needed
+ */
+void removeColumns(std::vector<DefectRun> const &runs, std::vector<bool> const &vertical,
+                   std::vector<DefectRun> &out) {
+    out.clear();
+    for (DefectRun const &run : runs) {
+        for (int x = run.x0; x <= run.x1;) {
+            for (; x <= run.x1 && vertical[x]; ++x) {
             }
-            if (x1 < defect->getX0() - 1) {  // no further defects can touch this one
-                --bri;
-                break;
+            int const x0 = x;
+            for (; x <= run.x1 && !vertical[x]; ++x) {
             }
-            if (defect->getX1() > x1) {
-                x1 = defect->getX1();
+            if (x > x0) {
+                out.push_back(DefectRun{x0, x - 1, Defect::MIDDLE, 0});
             }
         }
+    }
+}
 
-        int const nbad = x1 - x0 + 1;
-        assert(nbad >= 1);
+/*
+ * Find the runs of pixels with any of the bits in bitmask set in a line of n mask pixels, stride apart,
+ * replacing the contents of runs
+ */
+void findMaskedRuns(afw::image::MaskPixel const *const data, int const n, int const stride,
+                    afw::image::MaskPixel const bitmask, std::vector<DefectRun> &runs) {
+    runs.clear();
+    for (int x = 0; x < n; ++x) {
+        if (data[x * stride] & bitmask) {
+            int const x0 = x;
+            for (; x + 1 < n && (data[(x + 1) * stride] & bitmask); ++x) {
+            }
+            runs.push_back(DefectRun{x0, x, Defect::MIDDLE, 0});
+        }
+    }
+}
 
-        defect = Defect::Ptr(new Defect(geom::BoxI(geom::Point2I(x0, y), geom::Extent2I(nbad, 1))));
-        badList1D.push_back(defect);
+/*
+ * Return the rectangles formed by identical runs of pixels with any of the bits in bitmask set in
+ * consecutive rows of a mask whose rows are stride apart
+ */
+std::vector<geom::BoxI> findMaskedBoxes(afw::image::MaskPixel const *const data, int const width,
+                                        int const height, int const stride,
+                                        afw::image::MaskPixel const bitmask) {
+    std::vector<geom::BoxI> boxes;
+    std::vector<DefectRun> runs;     // this row's runs
+    std::vector<geom::BoxI> open;    // rectangles that reach the previous row, sorted by x0
+    std::vector<geom::BoxI> extended;  // rectangles that reach this row, sorted by x0
+    for (int y = 0; y <= height; ++y) {
+        if (y < height) {
+            findMaskedRuns(data + y * stride, width, 1, bitmask, runs);
+        } else {
+            runs.clear();  // close all the open rectangles
+        }
 
-        if (bri == end) {
-            break;
+        extended.clear();
+        std::size_t i = 0;  // index into open
+        for (DefectRun const &run : runs) {
+            for (; i != open.size() && open[i].getMinX() < run.x0; ++i) {  // can't be extended
+                boxes.push_back(open[i]);
+            }
+            if (i != open.size() && open[i].getMinX() == run.x0 && open[i].getMaxX() == run.x1) {
+                extended.push_back(geom::BoxI(open[i].getMin(), geom::PointI(run.x1, y)));
+                ++i;
+            } else {
+                extended.push_back(geom::BoxI(geom::PointI(run.x0, y), geom::PointI(run.x1, y)));
+            }
         }
+        boxes.insert(boxes.end(), open.begin() + i, open.end());
+        open.swap(extended);
     }
-    //
-    // Now process our new list
-    //
-    for (DefectCIter begin = badList1D.begin(), end = badList1D.end(), bri = begin; bri != end; ++bri) {
-        Defect::Ptr defect = *bri;
 
-        int const nbad = defect->getX1() - defect->getX0() + 1;
+    return boxes;
+}
+}  // namespace
+
+/************************************************************************************************************/
+/*
+ * Classify a row's runs of bad pixels, which must be sorted and mutually non-adjacent (e.g. as
+ * returned by ActiveDefects::merge).
+ *
+ * See comment above do_defects for a description of how to interpret DefectType
+ */
+static void classify_defects(DefectRun *const runs,  // runs of bad pixels in this row
+                             std::size_t const n,    // number of runs
+                             int const ncol          // number of columns in image
+) {
+    for (std::size_t i = 0; i != n; ++i) {
+        DefectRun &defect = runs[i];
+
+        int const nbad = defect.x1 - defect.x0 + 1;
         assert(nbad >= 1);
 
-        if (defect->getX0() == 0) {
+        if (defect.x0 == 0) {
             if (nbad >= Defect::WIDE_DEFECT) {
-                defect->classify(Defect::WIDE_LEFT, 03);
+                defect.pos = Defect::WIDE_LEFT;
+                defect.type = 03;
             } else {
-                defect->classify(Defect::LEFT, 03 << nbad);
+                defect.pos = Defect::LEFT;
+                defect.type = 03 << nbad;
             }
-        } else if (defect->getX0() == 1) { /* only second column is usable */
+        } else if (defect.x0 == 1) { /* only second column is usable */
             if (nbad >= Defect::WIDE_DEFECT) {
-                defect->classify(Defect::WIDE_NEAR_LEFT, (01 << 2) | 03);
+                defect.pos = Defect::WIDE_NEAR_LEFT;
+                defect.type = (01 << 2) | 03;
             } else {
-                defect->classify(Defect::NEAR_LEFT, (01 << (nbad + 2)) | 03);
+                defect.pos = Defect::NEAR_LEFT;
+                defect.type = (01 << (nbad + 2)) | 03;
             }
-        } else if (defect->getX1() == ncol - 2) { /* use only penultimate column */
+        } else if (defect.x1 == ncol - 2) { /* use only penultimate column */
             if (nbad >= Defect::WIDE_DEFECT) {
-                defect->classify(Defect::WIDE_NEAR_RIGHT, (03 << 2) | 02);
+                defect.pos = Defect::WIDE_NEAR_RIGHT;
+                defect.type = (03 << 2) | 02;
             } else {
-                defect->classify(Defect::NEAR_RIGHT, (03 << (nbad + 2)) | 02);
+                defect.pos = Defect::NEAR_RIGHT;
+                defect.type = (03 << (nbad + 2)) | 02;
             }
-        } else if (defect->getX1() == ncol - 1) {
+        } else if (defect.x1 == ncol - 1) {
             if (nbad >= Defect::WIDE_DEFECT) {
-                defect->classify(Defect::WIDE_RIGHT, 03);
+                defect.pos = Defect::WIDE_RIGHT;
+                defect.type = 03;
             } else {
-                defect->classify(Defect::RIGHT, 03 << nbad);
+                defect.pos = Defect::RIGHT;
+                defect.type = 03 << nbad;
             }
         } else if (nbad >= Defect::WIDE_DEFECT) {
-            defect->classify(Defect::WIDE, (03 << 2) | 03);
+            defect.pos = Defect::WIDE;
+            defect.type = (03 << 2) | 03;
         } else {
-            defect->classify(Defect::MIDDLE, (03 << (nbad + 2)) | 03);
+            defect.pos = Defect::MIDDLE;
+            defect.type = (03 << (nbad + 2)) | 03;
         }
         /*
          * look for bad columns in regions that we'll get `good' values from.
@@ -145,7 +261,7 @@ static std::vector<Defect::Ptr> classify_defects(
          * We know that no two Defects are adjacent.
          */
         int nshift = 0;  // number of bits to shift to get to left edge of defect pattern
-        switch (defect->getPos()) {
+        switch (defect.pos) {
             case Defect::WIDE:             // no bits
             case Defect::WIDE_NEAR_LEFT:   //       are used to encode
             case Defect::WIDE_NEAR_RIGHT:  //            the bad section of data
@@ -156,30 +272,27 @@ static std::vector<Defect::Ptr> classify_defects(
                 break;
         }
 
-        if (bri != begin) {
-            Defect::Ptr const defect_m = *(bri - 1);
-            assert(defect_m->getX1() < defect->getX0());
+        if (i != 0) {
+            DefectRun const &defect_m = runs[i - 1];
+            assert(defect_m.x1 < defect.x0);
 
-            if (defect_m->getX1() == defect->getX0() - 2) {
-                defect->classify(defect->getPos(), (defect->getType() & ~(02 << (nshift + 2))));
+            if (defect_m.x1 == defect.x0 - 2) {
+                defect.type &= ~(02 << (nshift + 2));
             }
         }
 
-        if (bri + 1 != end) {
-            Defect::Ptr const defect_p = *(bri + 1);
+        if (i + 1 != n) {
+            DefectRun const &defect_p = runs[i + 1];
 
-            if (defect->getX1() == defect_p->getX0() - 2) {
-                Defect::DefectPosition defectPos = defect->getPos();
-                if (defectPos == Defect::LEFT || defectPos == Defect::NEAR_LEFT) {
-                    defect->classify(defect->getPos(), (defect->getType() & ~(02 << nshift)));
+            if (defect.x1 == defect_p.x0 - 2) {
+                if (defect.pos == Defect::LEFT || defect.pos == Defect::NEAR_LEFT) {
+                    defect.type &= ~(02 << nshift);
                 } else {
-                    defect->classify(defectPos, (defect->getType() & ~01));
+                    defect.type &= ~01;
                 }
             }
         }
     }
-
-    return badList1D;
 }
 
 /*****************************************************************************/
@@ -199,13 +312,15 @@ static std::vector<Defect::Ptr> classify_defects(
  * written as 110000 not 000011).
  */
 template <typename ImageT>
-static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad things
-                       int const y,                              // Row that we should fix
-                       ImageT &data,                             // data to fix
-                       typename ImageT::Pixel min,               // minimum acceptable value
-                       double fallbackValue,                     // Value to fallback to if all else fails
-                       bool useFallbackValueAtEdge,              // use fallbackValue at edge of chip?
-                       int nUseInterp                            // no. of pixels to interpolate towards edge
+static void do_defects(DefectRun const *const begin,  // first classified run of bad pixels in row y
+                       DefectRun const *const end,    // one past the last run in row y
+                       int const y,                   // Row that we should fix
+                       ImageT &data,                  // data to fix
+                       typename ImageT::Pixel min,    // minimum acceptable value
+                       double fallbackValue,          // Value to fallback to if all else fails
+                       bool useFallbackValueAtEdge,   // use fallbackValue at edge of chip?
+                       int nUseInterp,                // no. of pixels to interpolate towards edge
+                       long &nFallback                // incremented by no. of pixels set to fallbackValue
 ) {
     typedef typename ImageT::Pixel ImagePixel;
     ImagePixel out1_2, out1_1, out2_1, out2_2;  // == out[badX1-2], ..., out[bad_x2+2]
@@ -216,18 +331,12 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
     int const ncol = data.getWidth();
     typename ImageT::x_iterator out = data.row_begin(y);
 
-    for (DefectCIter ptr = badList.begin(), end = badList.end(); ptr != end; ++ptr) {
-        Defect::Ptr const defect = *ptr;
+    for (DefectRun const *defect = begin; defect != end; ++defect) {
+        int badX0 = defect->x0;
+        int badX1 = defect->x1;
 
-        if (y < defect->getY0() || y > defect->getY1()) {
-            continue;
-        }
-
-        int badX0 = defect->getX0();
-        int badX1 = defect->getX1();
-
-        Defect::DefectPosition defectPos = defect->getPos();
-        unsigned int defectType = defect->getType();
+        Defect::DefectPosition defectPos = defect->pos;
+        unsigned int defectType = defect->type;
 
         int nbad = badX1 - badX0 + 1;
 
@@ -241,11 +350,13 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
                         for (int i = 0; i != ncol; ++i) {
                             out[i] = fallbackValue;
                         }
+                        nFallback += ncol;
                         continue;
                     }
 
                     for (; badX0 <= badX1 - nUseInterp; ++badX0) {
                         out[badX0] = fallbackValue;
+                        ++nFallback;
                     }
 
                     if (defectPos == Defect::LEFT) {
@@ -272,6 +383,7 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
                     assert(badX1 == ncol - 1);
                     for (; badX1 >= badX0 + nUseInterp; --badX1) {
                         out[badX1] = fallbackValue;
+                        ++nFallback;
                     }
                     nbad = badX1 - badX0 + 1;
                     defectType = (03 << (nbad + 2)) | 03;
@@ -587,6 +699,7 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
                         val = out[ncol - 1];
                     } else {
                         val = fallbackValue; /* there is no information */
+                        nFallback += badX1 - badX0 + 1;
                     }
                     for (int j = badX0; j <= badX1; j++) {
                         out[j] = val;
@@ -846,6 +959,7 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
                         val = out[0];
                     } else {
                         val = fallbackValue; /* there is no information */
+                        nFallback += badX1 - badX0 + 1;
                     }
                     for (int j = badX0; j <= badX1; j++) {
                         out[j] = val;
@@ -1778,6 +1892,7 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
                             val = out[ncol - 1];
                         } else {
                             val = fallbackValue; /* there is no information */
+                            nFallback += badX1 - badX0 + 1;
                         }
                         for (int j = badX0; j <= badX1; j++) {
                             out[j] = val;
@@ -1799,6 +1914,7 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
                             val = out[0];
                         } else {
                             val = fallbackValue; /* there is no information */
+                            nFallback += badX1 - badX0 + 1;
                         }
                         for (int j = badX0; j <= badX1; j++) {
                             out[j] = val;
@@ -2004,24 +2120,19 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
 }
 
 template <typename MaskT>
-static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad things
-                       int const y,                              // Row that we should fix
-                       MaskT &mask,                              // mask to set
-                       typename MaskT::Pixel const interpBit,    // bit to set for bad pixels
-                       bool useFallbackValueAtEdge,              // use fallbackValue at edge of chip?
-                       int nUseInterp                            // no. of pixels to interpolate towards edge
+static void do_defects(DefectRun const *const begin,          // first classified run of bad pixels in row y
+                       DefectRun const *const end,            // one past the last run in row y
+                       int const y,                           // Row that we should fix
+                       MaskT &mask,                           // mask to set
+                       typename MaskT::Pixel const interpBit,  // bit to set for bad pixels
+                       bool useFallbackValueAtEdge,           // use fallbackValue at edge of chip?
+                       int nUseInterp                         // no. of pixels to interpolate towards edge
 ) {
     typename MaskT::x_iterator mask_row = mask.row_begin(y);  // pointer to this row of mask
 
-    for (DefectCIter ptr = badList.begin(), end = badList.end(); ptr != end; ++ptr) {
-        Defect::Ptr const defect = *ptr;
-
-        if (y < defect->getY0() || y > defect->getY1()) {
-            continue;
-        }
-
-        int const badX0 = defect->getX0();
-        int const badX1 = defect->getX1();
+    for (DefectRun const *defect = begin; defect != end; ++defect) {
+        int const badX0 = defect->x0;
+        int const badX1 = defect->x1;
 
         for (int c = badX0; c <= badX1; ++c) {
             mask_row[c] |= interpBit;
@@ -2031,15 +2142,6 @@ static void do_defects(std::vector<Defect::Ptr> const &badList,  // list of bad
 
 /************************************************************************************************************/
 
-namespace {
-template <typename T>
-struct Sort_ByX0 : public std::binary_function<std::shared_ptr<T> const, std::shared_ptr<T> const, bool> {
-    bool operator()(std::shared_ptr<T> const a, std::shared_ptr<T> const b) const {
-        return a->getX0() < b->getX0();
-    }
-};
-}  // namespace
-
 /*!
  * @brief Process a set of known bad pixels in an image
  */
@@ -2048,20 +2150,40 @@ void interpolateOverDefects(MaskedImageT &mimage,                ///< Image to p
                             afw::detection::Psf const &,         ///< the Image's PSF
                             std::vector<Defect::Ptr> &_badList,  ///< List of Defects to patch
                             double fallbackValue,                ///< Value to fallback to if all else fails
-                            bool useFallbackValueAtEdge  ///< Use the fallback value at the image's edge?
+                            bool useFallbackValueAtEdge,  ///< Use the fallback value at the image's edge?
+                            int nThreads,  ///< Number of threads to use; <= 0 means all available
+                            double columnAspectRatio  ///< Interpolate tall defects vertically; see DefectPlan
 ) {
+    DefectPlan(_badList, mimage.getBBox(), columnAspectRatio)
+            .apply(mimage, fallbackValue, useFallbackValueAtEdge, nThreads);
+}
+
+template <typename MaskedImageT>
+DefectInterpolationStatistics interpolateOverMask(MaskedImageT &mimage,
+                                                  typename MaskedImageT::Mask::Pixel bitmask,
+                                                  double fallbackValue, bool useFallbackValueAtEdge,
+                                                  int nThreads, double columnAspectRatio) {
+    return DefectPlan(*mimage.getMask(), bitmask, columnAspectRatio)
+            .apply(mimage, fallbackValue, useFallbackValueAtEdge, nThreads);
+}
+
+/************************************************************************************************************/
+
+DefectPlan::DefectPlan(std::vector<Defect::Ptr> const &badList, geom::Box2I const &bbox,
+                       double columnAspectRatio)
+        : _bbox(bbox), _rowBegin(), _runs(), _columns(), _columnBegin(), _columnRuns() {
+    int const width = bbox.getWidth();
+    int const height = bbox.getHeight();
     /*
-     * Allow for image's origin
+     * Allow for image's origin, and clip to the image
      */
-    int const width = mimage.getWidth();
-    int const height = mimage.getHeight();
-
-    std::vector<Defect::Ptr> badList;
-    badList.reserve(_badList.size());
-    for (std::vector<Defect::Ptr>::iterator ptr = _badList.begin(), end = _badList.end(); ptr != end; ++ptr) {
-        geom::BoxI bbox = (*ptr)->getBBox();
-        bbox.shift(geom::ExtentI(-mimage.getX0(), -mimage.getY0()));  // allow for image's origin
-        geom::PointI min = bbox.getMin(), max = bbox.getMax();
+    std::vector<geom::BoxI> boxes;
+    boxes.reserve(badList.size());
+    for (std::vector<Defect::Ptr>::const_iterator ptr = badList.begin(), end = badList.end(); ptr != end;
+         ++ptr) {
+        geom::BoxI box = (*ptr)->getBBox();
+        box.shift(geom::ExtentI(-bbox.getMinX(), -bbox.getMinY()));  // allow for image's origin
+        geom::PointI min = box.getMin(), max = box.getMax();
         if (min.getX() >= width) {
             continue;
         } else if (min.getX() < 0) {
@@ -2078,149 +2200,865 @@ void interpolateOverDefects(MaskedImageT &mimage,                ///< Image to p
             max.setX(width - 1);
         }
 
-        bbox = geom::BoxI(min, max);
-        Defect::Ptr ndefect(new Defect(bbox));
-        ndefect->classify((*ptr)->getPos(), (*ptr)->getType());
-        badList.push_back(ndefect);
+        if (min.getY() >= height || max.getY() < 0) {
+            continue;
+        }
+        min.setY(std::max(min.getY(), 0));
+        max.setY(std::min(max.getY(), height - 1));
+
+        boxes.push_back(geom::BoxI(min, max));
+    }
+    /*
+     * Choose the columns to interpolate vertically, and merge and classify their runs of bad pixels.
+     * The defects are transposed so that an ActiveDefects can sweep along the columns
+     */
+    std::vector<bool> vertical(width, false);
+    if (columnAspectRatio > 0) {
+        for (geom::BoxI const &box : boxes) {
+            if (box.getHeight() >= columnAspectRatio * box.getWidth()) {
+                std::fill(vertical.begin() + box.getMinX(), vertical.begin() + box.getMaxX() + 1, true);
+            }
+        }
+    }
+    bool const anyVertical = std::find(vertical.begin(), vertical.end(), true) != vertical.end();
+
+    std::vector<DefectRun> badList1D;  // this row's runs of bad pixels; reused to avoid reallocation
+    if (anyVertical) {
+        std::vector<geom::BoxI> transposed;
+        transposed.reserve(boxes.size());
+        for (geom::BoxI const &box : boxes) {
+            transposed.push_back(geom::BoxI(geom::PointI(box.getMinY(), box.getMinX()),
+                                            geom::PointI(box.getMaxY(), box.getMaxX())));
+        }
+        ActiveDefects activeDefects(std::move(transposed));
+
+        for (int x = 0; x != width; x++) {
+            if (!vertical[x]) {
+                continue;
+            }
+            _columns.push_back(x);
+            _columnBegin.push_back(_columnRuns.size());
+
+            activeDefects.advance(x);
+            activeDefects.merge(badList1D);
+            classify_defects(badList1D.data(), badList1D.size(), height);
+            _columnRuns.insert(_columnRuns.end(), badList1D.begin(), badList1D.end());
+        }
+    }
+    _columnBegin.push_back(_columnRuns.size());
+    /*
+     * Merge and classify the defects in each row, leaving out the columns that we've already handled
+     */
+    ActiveDefects activeDefects(std::move(boxes));
+
+    _rowBegin.reserve(height + 1);
+    std::vector<DefectRun> rowRuns;  // badList1D without the vertically interpolated columns
+    for (int y = 0; y != height; y++) {
+        _rowBegin.push_back(_runs.size());
+
+        activeDefects.advance(y);
+        activeDefects.merge(badList1D);
+        if (anyVertical) {
+            removeColumns(badList1D, vertical, rowRuns);
+            badList1D.swap(rowRuns);
+        }
+        classify_defects(badList1D.data(), badList1D.size(), width);
+        _runs.insert(_runs.end(), badList1D.begin(), badList1D.end());
     }
+    _rowBegin.push_back(_runs.size());
+}
 
-    sort(badList.begin(), badList.end(), Sort_ByX0<Defect>());
+DefectPlan::DefectPlan(afw::image::Mask<afw::image::MaskPixel> const &mask, afw::image::MaskPixel bitmask,
+                       double columnAspectRatio)
+        : _bbox(mask.getBBox()),
+          _rowBegin(),
+          _runs(),
+          _columns(),
+          _columnBegin(),
+          _columnRuns() {
+    int const width = mask.getWidth();
+    int const height = mask.getHeight();
+    auto const array = mask.getArray();
+    afw::image::MaskPixel const *const data = array.getData();
+    int const stride = array.getStrides()[0];
     /*
-     * Go through the frame looking at each pixel (except the edge ones which we ignore)
+     * Choose the columns to interpolate vertically, as in the constructor from Defects, and find
+     * their runs of bad pixels
      */
-    typename MaskedImageT::Mask::Pixel const interpBit =
-            mimage.getMask()->getPlaneBitMask("INTRP");  // interp'd pixels
+    std::vector<bool> vertical(width, false);
+    std::vector<DefectRun> badList1D;  // this row's (or column's) runs of bad pixels
+    if (columnAspectRatio > 0) {
+        for (geom::BoxI const &box : findMaskedBoxes(data, width, height, stride, bitmask)) {
+            if (box.getHeight() >= columnAspectRatio * box.getWidth()) {
+                std::fill(vertical.begin() + box.getMinX(), vertical.begin() + box.getMaxX() + 1, true);
+            }
+        }
 
-    constexpr int nUseInterp = 6;  // no. of pixels to interpolate towards edge
-    static_assert(nUseInterp < Defect::WIDE_DEFECT,
-                  "make sure that we can handle these defects using"
-                  "the full interpolation not edge code");
+        for (int x = 0; x != width; x++) {
+            if (!vertical[x]) {
+                continue;
+            }
+            _columns.push_back(x);
+            _columnBegin.push_back(_columnRuns.size());
 
+            findMaskedRuns(data + x, height, stride, bitmask, badList1D);
+            classify_defects(badList1D.data(), badList1D.size(), height);
+            _columnRuns.insert(_columnRuns.end(), badList1D.begin(), badList1D.end());
+        }
+    }
+    _columnBegin.push_back(_columnRuns.size());
+    bool const anyVertical = !_columns.empty();
+    /*
+     * Find and classify the runs in each row, leaving out the columns that we've already handled
+     */
+    _rowBegin.reserve(height + 1);
+    std::vector<DefectRun> rowRuns;  // badList1D without the vertically interpolated columns
     for (int y = 0; y != height; y++) {
-        std::vector<Defect::Ptr> badList1D = classify_defects(badList, y, width);
+        _rowBegin.push_back(_runs.size());
 
-        do_defects(badList1D, y, *mimage.getImage(),
-                   -std::numeric_limits<typename MaskedImageT::Image::Pixel>::max(), fallbackValue,
-                   useFallbackValueAtEdge, nUseInterp);
+        findMaskedRuns(data + y * stride, width, 1, bitmask, badList1D);
+        if (anyVertical) {
+            removeColumns(badList1D, vertical, rowRuns);
+            badList1D.swap(rowRuns);
+        }
+        classify_defects(badList1D.data(), badList1D.size(), width);
+        _runs.insert(_runs.end(), badList1D.begin(), badList1D.end());
+    }
+    _rowBegin.push_back(_runs.size());
+}
 
-        do_defects(badList1D, y, *mimage.getMask(), interpBit, useFallbackValueAtEdge, nUseInterp);
+DefectPlan::DefectPlan(geom::Box2I const &bbox, std::vector<std::size_t> rowBegin,
+                       std::vector<DefectRun> runs, std::vector<int> columns,
+                       std::vector<std::size_t> columnBegin, std::vector<DefectRun> columnRuns)
+        : _bbox(bbox),
+          _rowBegin(std::move(rowBegin)),
+          _runs(std::move(runs)),
+          _columns(std::move(columns)),
+          _columnBegin(std::move(columnBegin)),
+          _columnRuns(std::move(columnRuns)) {}
+
+std::vector<DefectRun> DefectPlan::getRuns(int y) const {
+    if (y < 0 || y >= _bbox.getHeight()) {
+        throw LSST_EXCEPT(pex::exceptions::OutOfRangeError,
+                          (boost::format("Row %d is not in [0, %d)") % y % _bbox.getHeight()).str());
+    }
+    return std::vector<DefectRun>(_runs.begin() + _rowBegin[y], _runs.begin() + _rowBegin[y + 1]);
+}
 
-        do_defects(badList1D, y, *mimage.getVariance(),
-                   -std::numeric_limits<typename MaskedImageT::Image::Pixel>::max(), fallbackValue,
-                   useFallbackValueAtEdge, nUseInterp);
+std::vector<DefectRun> DefectPlan::getColumnRuns(int x) const {
+    if (x < 0 || x >= _bbox.getWidth()) {
+        throw LSST_EXCEPT(pex::exceptions::OutOfRangeError,
+                          (boost::format("Column %d is not in [0, %d)") % x % _bbox.getWidth()).str());
+    }
+    std::vector<int>::const_iterator const column = std::lower_bound(_columns.begin(), _columns.end(), x);
+    if (column == _columns.end() || *column != x) {
+        return std::vector<DefectRun>();
     }
+    std::size_t const i = column - _columns.begin();
+    return std::vector<DefectRun>(_columnRuns.begin() + _columnBegin[i],
+                                  _columnRuns.begin() + _columnBegin[i + 1]);
 }
 
-/*****************************************************************************/
-/**
- *
- * Return a boolean status (true: interpolation is OK) and the interpolated value for a pixel,
- * ignoring pixels given by badmask
- *
- * Interpolation can either be vertical or horizontal
+namespace {
+
+constexpr int nUseInterp = 6;  // no. of pixels to interpolate towards edge
+static_assert(nUseInterp < Defect::WIDE_DEFECT,
+              "make sure that we can handle these defects using"
+              "the full interpolation not edge code");
+
+/*
+ * Interpolate over the runs [begin, end) in row y of an image's three planes, accumulating statistics
+ */
+template <typename MaskedImageT>
+void interpolateRow(DefectRun const *const begin, DefectRun const *const end, int const y,
+                    typename MaskedImageT::Image &image, typename MaskedImageT::Mask &mask,
+                    typename MaskedImageT::Variance &variance,
+                    typename MaskedImageT::Mask::Pixel const interpBit, double fallbackValue,
+                    bool useFallbackValueAtEdge, DefectInterpolationStatistics &stats) {
+    typedef typename MaskedImageT::Image::Pixel ImagePixel;
+
+    do_defects(begin, end, y, image, -std::numeric_limits<ImagePixel>::max(), fallbackValue,
+               useFallbackValueAtEdge, nUseInterp, stats.nFallback);
+
+    do_defects(begin, end, y, mask, interpBit, useFallbackValueAtEdge, nUseInterp);
+
+    long nFallbackVariance = 0;  // the same as for the image
+    do_defects(begin, end, y, variance, -std::numeric_limits<ImagePixel>::max(), fallbackValue,
+               useFallbackValueAtEdge, nUseInterp, nFallbackVariance);
+
+    typename MaskedImageT::Image::x_iterator const out = image.row_begin(y);
+    for (DefectRun const *defect = begin; defect != end; ++defect) {
+        stats.nPixel += defect->x1 - defect->x0 + 1;
+        for (int x = defect->x0; x <= defect->x1; ++x) {
+            if (!std::isfinite(out[x])) {
+                ++stats.nNonFinite;
+            }
+        }
+    }
+}
+
+/*
+ * Some of the columns of an image, transposed so that do_defects can process them as rows
  *
- * @note: This is a pretty expensive routine, so use only after suitable thought.
+ * The columns are copied a row at a time, so adjacent columns (e.g. a bleed trail a few pixels wide)
+ * are read together rather than striding through the image once per column.
+ */
+template <typename PixelT>
+class ColumnBuffer {
+public:
+    typedef PixelT Pixel;
+    typedef PixelT *x_iterator;
+
+    template <typename ImageT>
+    ColumnBuffer(ImageT &image, int const *const columns, int const nColumn)
+            : _height(image.getHeight()), _data(static_cast<std::size_t>(nColumn) * _height) {
+        for (int y = 0; y != _height; ++y) {
+            typename ImageT::x_iterator const in = image.row_begin(y);
+            for (int i = 0; i != nColumn; ++i) {
+                _data[static_cast<std::size_t>(i) * _height + y] = in[columns[i]];
+            }
+        }
+    }
+
+    int getWidth() const { return _height; }
+    x_iterator row_begin(int i) { return _data.data() + static_cast<std::size_t>(i) * _height; }
+
+private:
+    int _height;
+    std::vector<PixelT> _data;
+};
+
+/*
+ * Interpolate vertically over the runs in nColumn columns of an image's three planes, accumulating
+ * statistics; columnBegin[i] is the index in runs of the first of columns[i]'s runs
  */
 template <typename MaskedImageT>
-std::pair<bool, typename MaskedImageT::Image::Pixel> interp::singlePixel(
-        int,                   ///< x: column coordinate of the pixel in question
-        int,                   ///< y: row coordinate of the pixel in question
-        MaskedImageT const &,  ///< image: in this image
-        bool,                  ///< horizontal: interpolate horizontally?
-        double                 ///< minval: minimum acceptable value
-) {
-#if defined(SDSS)
-    BADCOLUMN defect; /* describe a bad column */
-    PIX *data;        /* temp array to interpolate in */
-    int i;
-    int i0, i1;               /* data corresponds to range of
-                                {row,col} == [i0,i1] */
-    int ndata;                /* dimension of data */
-    static int ndatamax = 40; /* largest allowable defect. XXX */
-    int nrow, ncol;           /* == reg->n{row,col} */
-    PIX *val;                 /* pointer to pixel (rowc, colc) */
-    int z1, z2;               /* range of bad {row,columns} */
-
-    shAssert(badmask != NULL && badmask->type == shTypeGetFromName("OBJMASK"));
-    shAssert(reg != NULL && reg->type == TYPE_PIX);
-    nrow = reg->nrow;
-    ncol = reg->ncol;
-
-    if (horizontal) {
-        for (z1 = colc - 1; z1 >= 0; z1--) {
-            if (!phPixIntersectMask(badmask, z1, rowc)) {
-                break;
+void interpolateColumns(int const *const columns, int const nColumn, std::size_t const *const columnBegin,
+                        DefectRun const *const runs, MaskedImageT &mimage,
+                        typename MaskedImageT::Mask::Pixel const interpBit, double fallbackValue,
+                        bool useFallbackValueAtEdge, DefectInterpolationStatistics &stats) {
+    typedef typename MaskedImageT::Image::Pixel ImagePixel;
+    typedef typename MaskedImageT::Variance::Pixel VariancePixel;
+
+    typename MaskedImageT::Image &image = *mimage.getImage();
+    typename MaskedImageT::Mask &mask = *mimage.getMask();
+    typename MaskedImageT::Variance &variance = *mimage.getVariance();
+
+    ColumnBuffer<ImagePixel> imageColumns(image, columns, nColumn);
+    ColumnBuffer<VariancePixel> varianceColumns(variance, columns, nColumn);
+
+    for (int i = 0; i != nColumn; ++i) {
+        DefectRun const *const begin = runs + columnBegin[i];
+        DefectRun const *const end = runs + columnBegin[i + 1];
+
+        do_defects(begin, end, i, imageColumns, -std::numeric_limits<ImagePixel>::max(), fallbackValue,
+                   useFallbackValueAtEdge, nUseInterp, stats.nFallback);
+
+        long nFallbackVariance = 0;  // the same as for the image
+        do_defects(begin, end, i, varianceColumns, -std::numeric_limits<ImagePixel>::max(), fallbackValue,
+                   useFallbackValueAtEdge, nUseInterp, nFallbackVariance);
+        /*
+         * Only the bad pixels have changed, so that's all that we need to copy back
+         */
+        int const x = columns[i];
+        typename ColumnBuffer<ImagePixel>::x_iterator const imageColumn = imageColumns.row_begin(i);
+        typename ColumnBuffer<VariancePixel>::x_iterator const varianceColumn = varianceColumns.row_begin(i);
+        for (DefectRun const *defect = begin; defect != end; ++defect) {
+            stats.nPixel += defect->x1 - defect->x0 + 1;
+            for (int y = defect->x0; y <= defect->x1; ++y) {
+                image.row_begin(y)[x] = imageColumn[y];
+                mask.row_begin(y)[x] |= interpBit;
+                variance.row_begin(y)[x] = varianceColumn[y];
+                if (!std::isfinite(imageColumn[y])) {
+                    ++stats.nNonFinite;
+                }
             }
         }
-        z1++;
+    }
+}
 
-        for (z2 = colc + 1; z2 < ncol; z2++) {
-            if (!phPixIntersectMask(badmask, z2, rowc)) {
-                break;
+}  // namespace
+
+template <typename MaskedImageT>
+DefectInterpolationStatistics DefectPlan::apply(MaskedImageT &mimage, double fallbackValue,
+                                                bool useFallbackValueAtEdge, int nThreads) const {
+    return _apply(std::vector<MaskedImageT *>(1, &mimage), fallbackValue, useFallbackValueAtEdge, nThreads)
+            .front();
+}
+
+template <typename MaskedImageT>
+std::vector<DefectInterpolationStatistics> DefectPlan::applyBatch(
+        std::vector<std::shared_ptr<MaskedImageT>> const &images, double fallbackValue,
+        bool useFallbackValueAtEdge, int nThreads) const {
+    std::vector<MaskedImageT *> imagePtrs;
+    imagePtrs.reserve(images.size());
+    for (std::size_t i = 0; i != images.size(); ++i) {
+        if (!images[i]) {
+            throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                              (boost::format("Image %d is null") % i).str());
+        }
+        imagePtrs.push_back(images[i].get());
+    }
+
+    return _apply(imagePtrs, fallbackValue, useFallbackValueAtEdge, nThreads);
+}
+
+template <typename MaskedImageT>
+std::vector<DefectInterpolationStatistics> DefectPlan::_apply(std::vector<MaskedImageT *> const &images,
+                                                              double fallbackValue,
+                                                              bool useFallbackValueAtEdge,
+                                                              int nThreads) const {
+    int const nImage = images.size();
+    std::vector<typename MaskedImageT::Mask::Pixel> interpBits;  // interp'd pixels
+    interpBits.reserve(nImage);
+    for (MaskedImageT const *mimage : images) {
+        if (mimage->getBBox() != _bbox) {
+            throw LSST_EXCEPT(pex::exceptions::LengthError,
+                              (boost::format("Image's bounding box (%d, %d)--(%d, %d) doesn't match the "
+                                             "DefectPlan's (%d, %d)--(%d, %d)") %
+                               mimage->getBBox().getMinX() % mimage->getBBox().getMinY() %
+                               mimage->getBBox().getMaxX() % mimage->getBBox().getMaxY() % _bbox.getMinX() %
+                               _bbox.getMinY() % _bbox.getMaxX() % _bbox.getMaxY())
+                                      .str());
+        }
+        interpBits.push_back(mimage->getMask()->getPlaneBitMask("INTRP"));
+    }
+    /*
+     * First interpolate along the columns that the plan handles vertically.  Each column only reads
+     * and writes its own pixels, so blocks of columns may be processed in any order (and in parallel)
+     * without changing the result.
+     */
+    int const nColumn = _columns.size();
+    int const columnsPerBlock = 16;  // amortise the cost of handing out work to threads
+    int const nColumnBlock = (nColumn + columnsPerBlock - 1) / columnsPerBlock;
+    /*
+     * Then interpolate along the rows, which now see the columns that we just repaired as good.
+     * Each row only reads and writes its own pixels, so blocks of rows may also be processed in
+     * any order.  Within a block we apply each row's runs to all the images before moving on to
+     * the next row.
+     */
+    int const height = _bbox.getHeight();
+    int const rowsPerBlock = 16;  // amortise the cost of handing out work to threads
+    int const nRowBlock = (height + rowsPerBlock - 1) / rowsPerBlock;
+
+    int const nBlock = nColumnBlock + nRowBlock;  // the column blocks come first
+    std::vector<DefectInterpolationStatistics> blockStats(nBlock * nImage);  // indexed by [block][image]
+    detail::parallelFor(nColumnBlock, nThreads, [&](int block) {
+        int const i0 = block * columnsPerBlock;
+        for (int i = 0; i != nImage; ++i) {
+            interpolateColumns<MaskedImageT>(_columns.data() + i0, std::min(columnsPerBlock, nColumn - i0),
+                                             _columnBegin.data() + i0, _columnRuns.data(), *images[i],
+                                             interpBits[i], fallbackValue, useFallbackValueAtEdge,
+                                             blockStats[block * nImage + i]);
+        }
+    });
+    detail::parallelFor(nRowBlock, nThreads, [&](int rowBlock) {
+        int const block = nColumnBlock + rowBlock;
+        for (int y = rowBlock * rowsPerBlock, yEnd = std::min(y + rowsPerBlock, height); y < yEnd; y++) {
+            if (_rowBegin[y] == _rowBegin[y + 1]) {
+                continue;
+            }
+            DefectRun const *const begin = _runs.data() + _rowBegin[y];
+            DefectRun const *const end = _runs.data() + _rowBegin[y + 1];
+
+            for (int i = 0; i != nImage; ++i) {
+                MaskedImageT &mimage = *images[i];
+                interpolateRow<MaskedImageT>(begin, end, y, *mimage.getImage(), *mimage.getMask(),
+                                             *mimage.getVariance(), interpBits[i], fallbackValue,
+                                             useFallbackValueAtEdge, blockStats[block * nImage + i]);
             }
         }
-        z2--;
+    });
+
+    std::vector<DefectInterpolationStatistics> stats(nImage);
+    for (int block = 0; block != nBlock; ++block) {
+        for (int i = 0; i != nImage; ++i) {
+            DefectInterpolationStatistics const &bstats = blockStats[block * nImage + i];
+            stats[i].nPixel += bstats.nPixel;
+            stats[i].nFallback += bstats.nFallback;
+            stats[i].nNonFinite += bstats.nNonFinite;
+        }
+    }
+
+    return stats;
+}
+
+// ---------- Persistence -----------------------------------------------------------------------------------
+
+// For persistence of DefectPlan, we have three catalogs: the first has just one record, and contains
+// the bounding box of the images the plan applies to.  The second catalog has one record for each
+// classified run in a row, in order of increasing row and then x0, and the third one for each run in
+// a column that's interpolated vertically, in order of increasing column and then row.  Plans written
+// before the third catalog was added have no vertically interpolated columns.
+
+namespace {
 
-        i0 = (z1 > 2) ? z1 - 2 : 0;               /* origin of available required data */
-        i1 = (z2 < ncol - 2) ? z2 + 2 : ncol - 1; /* end of "      "   "    "  */
+// Singleton class that manages the first persistence catalog's schema and keys
+class DefectPlanPersistenceKeys1 {
+public:
+    afw::table::Schema schema;
+    afw::table::PointKey<int> bboxMin;
+    afw::table::PointKey<int> bboxMax;
 
-        if (i0 < 2 || i1 >= ncol - 2) { /* interpolation will fail */
-            return (-1);                /* failure */
+    static DefectPlanPersistenceKeys1 const &get() {
+        static DefectPlanPersistenceKeys1 const instance;
+        return instance;
+    }
+
+    // No copying
+    DefectPlanPersistenceKeys1(const DefectPlanPersistenceKeys1 &) = delete;
+    DefectPlanPersistenceKeys1 &operator=(const DefectPlanPersistenceKeys1 &) = delete;
+
+    // No moving
+    DefectPlanPersistenceKeys1(DefectPlanPersistenceKeys1 &&) = delete;
+    DefectPlanPersistenceKeys1 &operator=(DefectPlanPersistenceKeys1 &&) = delete;
+
+private:
+    DefectPlanPersistenceKeys1()
+            : schema(),
+              bboxMin(afw::table::PointKey<int>::addFields(schema, "bbox_min",
+                                                           "lower-left corner of bounding box", "pixel")),
+              bboxMax(afw::table::PointKey<int>::addFields(schema, "bbox_max",
+                                                           "upper-right corner of bounding box", "pixel")) {
+        schema.getCitizen().markPersistent();
+    }
+};
+
+// Singleton class that manages the second persistence catalog's schema and keys
+class DefectPlanPersistenceKeys2 {
+public:
+    afw::table::Schema schema;
+    afw::table::Key<int> y;
+    afw::table::Key<int> x0;
+    afw::table::Key<int> x1;
+    afw::table::Key<int> pos;
+    afw::table::Key<int> type;
+
+    static DefectPlanPersistenceKeys2 const &get() {
+        static DefectPlanPersistenceKeys2 const instance;
+        return instance;
+    }
+
+    // No copying
+    DefectPlanPersistenceKeys2(const DefectPlanPersistenceKeys2 &) = delete;
+    DefectPlanPersistenceKeys2 &operator=(const DefectPlanPersistenceKeys2 &) = delete;
+
+    // No moving
+    DefectPlanPersistenceKeys2(DefectPlanPersistenceKeys2 &&) = delete;
+    DefectPlanPersistenceKeys2 &operator=(DefectPlanPersistenceKeys2 &&) = delete;
+
+private:
+    DefectPlanPersistenceKeys2()
+            : schema(),
+              y(schema.addField<int>("y", "row of the run, relative to the bounding box", "pixel")),
+              x0(schema.addField<int>("x0", "first column of the run, relative to the bbox", "pixel")),
+              x1(schema.addField<int>("x1", "last column of the run, relative to the bbox", "pixel")),
+              pos(schema.addField<int>("pos", "position of the run (a Defect::DefectPosition)")),
+              type(schema.addField<int>("type", "interpolation type of the run")) {
+        schema.getCitizen().markPersistent();
+    }
+};
+
+// Singleton class that manages the third persistence catalog's schema and keys
+class DefectPlanPersistenceKeys3 {
+public:
+    afw::table::Schema schema;
+    afw::table::Key<int> x;
+    afw::table::Key<int> y0;
+    afw::table::Key<int> y1;
+    afw::table::Key<int> pos;
+    afw::table::Key<int> type;
+
+    static DefectPlanPersistenceKeys3 const &get() {
+        static DefectPlanPersistenceKeys3 const instance;
+        return instance;
+    }
+
+    // No copying
+    DefectPlanPersistenceKeys3(const DefectPlanPersistenceKeys3 &) = delete;
+    DefectPlanPersistenceKeys3 &operator=(const DefectPlanPersistenceKeys3 &) = delete;
+
+    // No moving
+    DefectPlanPersistenceKeys3(DefectPlanPersistenceKeys3 &&) = delete;
+    DefectPlanPersistenceKeys3 &operator=(DefectPlanPersistenceKeys3 &&) = delete;
+
+private:
+    DefectPlanPersistenceKeys3()
+            : schema(),
+              x(schema.addField<int>("x", "column of the run, relative to the bounding box", "pixel")),
+              y0(schema.addField<int>("y0", "first row of the run, relative to the bbox", "pixel")),
+              y1(schema.addField<int>("y1", "last row of the run, relative to the bbox", "pixel")),
+              pos(schema.addField<int>("pos", "position of the run (a Defect::DefectPosition)")),
+              type(schema.addField<int>("type", "interpolation type of the run")) {
+        schema.getCitizen().markPersistent();
+    }
+};
+
+}  // namespace
+
+class DefectPlan::Factory : public afw::table::io::PersistableFactory {
+public:
+    virtual PTR(afw::table::io::Persistable)
+            read(InputArchive const &archive, CatalogVector const &catalogs) const {
+        DefectPlanPersistenceKeys1 const &keys1 = DefectPlanPersistenceKeys1::get();
+        DefectPlanPersistenceKeys2 const &keys2 = DefectPlanPersistenceKeys2::get();
+        DefectPlanPersistenceKeys3 const &keys3 = DefectPlanPersistenceKeys3::get();
+        LSST_ARCHIVE_ASSERT(catalogs.size() == 2u || catalogs.size() == 3u);
+        LSST_ARCHIVE_ASSERT(catalogs[0].getSchema() == keys1.schema);
+        LSST_ARCHIVE_ASSERT(catalogs[1].getSchema() == keys2.schema);
+        afw::table::BaseRecord const &record1 = catalogs[0].front();
+        geom::Box2I const bbox(record1.get(keys1.bboxMin), record1.get(keys1.bboxMax));
+        int const width = bbox.getWidth();
+        int const height = bbox.getHeight();
+
+        std::vector<std::size_t> rowBegin;
+        rowBegin.reserve(height + 1);
+        std::vector<DefectRun> runs;
+        runs.reserve(catalogs[1].size());
+        for (afw::table::BaseCatalog::const_iterator i = catalogs[1].begin(); i != catalogs[1].end(); ++i) {
+            int const y = i->get(keys2.y);
+            LSST_ARCHIVE_ASSERT(y >= static_cast<int>(rowBegin.size()) - 1 && y < height);
+            while (static_cast<int>(rowBegin.size()) <= y) {
+                rowBegin.push_back(runs.size());
+            }
+            runs.push_back(DefectRun{i->get(keys2.x0), i->get(keys2.x1),
+                                     static_cast<Defect::DefectPosition>(i->get(keys2.pos)),
+                                     static_cast<unsigned int>(i->get(keys2.type))});
+        }
+        while (static_cast<int>(rowBegin.size()) <= height) {
+            rowBegin.push_back(runs.size());
         }
 
-        ndata = (i1 - i0 + 1);
-        if (ndata > ndatamax) {
-            return (-1); /* failure */
+        std::vector<int> columns;
+        std::vector<std::size_t> columnBegin;
+        std::vector<DefectRun> columnRuns;
+        if (catalogs.size() == 3u) {
+            LSST_ARCHIVE_ASSERT(catalogs[2].getSchema() == keys3.schema);
+            columnRuns.reserve(catalogs[2].size());
+            for (afw::table::BaseCatalog::const_iterator i = catalogs[2].begin(); i != catalogs[2].end();
+                 ++i) {
+                int const x = i->get(keys3.x);
+                LSST_ARCHIVE_ASSERT(x >= 0 && x < width && (columns.empty() || x >= columns.back()));
+                if (columns.empty() || x != columns.back()) {
+                    columns.push_back(x);
+                    columnBegin.push_back(columnRuns.size());
+                }
+                columnRuns.push_back(DefectRun{i->get(keys3.y0), i->get(keys3.y1),
+                                               static_cast<Defect::DefectPosition>(i->get(keys3.pos)),
+                                               static_cast<unsigned int>(i->get(keys3.type))});
+            }
+        }
+        columnBegin.push_back(columnRuns.size());
+
+        return std::shared_ptr<DefectPlan>(new DefectPlan(bbox, std::move(rowBegin), std::move(runs),
+                                                          std::move(columns), std::move(columnBegin),
+                                                          std::move(columnRuns)));
+    }
+
+    Factory(std::string const &name) : afw::table::io::PersistableFactory(name) {}
+};
+
+namespace {
+
+std::string getDefectPlanPersistenceName() { return "DefectPlan"; }
+
+DefectPlan::Factory registration(getDefectPlanPersistenceName());
+
+}  // namespace
+
+std::string DefectPlan::getPersistenceName() const { return getDefectPlanPersistenceName(); }
+
+std::string DefectPlan::getPythonModule() const { return "lsst.meas.algorithms"; }
+
+void DefectPlan::write(OutputArchiveHandle &handle) const {
+    DefectPlanPersistenceKeys1 const &keys1 = DefectPlanPersistenceKeys1::get();
+    DefectPlanPersistenceKeys2 const &keys2 = DefectPlanPersistenceKeys2::get();
+    DefectPlanPersistenceKeys3 const &keys3 = DefectPlanPersistenceKeys3::get();
+    afw::table::BaseCatalog cat1 = handle.makeCatalog(keys1.schema);
+    PTR(afw::table::BaseRecord) record1 = cat1.addNew();
+    record1->set(keys1.bboxMin, _bbox.getMin());
+    record1->set(keys1.bboxMax, _bbox.getMax());
+    handle.saveCatalog(cat1);
+    afw::table::BaseCatalog cat2 = handle.makeCatalog(keys2.schema);
+    for (int y = 0, height = _bbox.getHeight(); y != height; ++y) {
+        for (std::size_t i = _rowBegin[y]; i != _rowBegin[y + 1]; ++i) {
+            DefectRun const &run = _runs[i];
+            PTR(afw::table::BaseRecord) record2 = cat2.addNew();
+            record2->set(keys2.y, y);
+            record2->set(keys2.x0, run.x0);
+            record2->set(keys2.x1, run.x1);
+            record2->set(keys2.pos, static_cast<int>(run.pos));
+            record2->set(keys2.type, static_cast<int>(run.type));
+        }
+    }
+    handle.saveCatalog(cat2);
+    afw::table::BaseCatalog cat3 = handle.makeCatalog(keys3.schema);
+    for (std::size_t c = 0; c != _columns.size(); ++c) {
+        for (std::size_t i = _columnBegin[c]; i != _columnBegin[c + 1]; ++i) {
+            DefectRun const &run = _columnRuns[i];
+            PTR(afw::table::BaseRecord) record3 = cat3.addNew();
+            record3->set(keys3.x, _columns[c]);
+            record3->set(keys3.y0, run.x0);
+            record3->set(keys3.y1, run.x1);
+            record3->set(keys3.pos, static_cast<int>(run.pos));
+            record3->set(keys3.type, static_cast<int>(run.type));
         }
+    }
+    handle.saveCatalog(cat3);
+}
+
+// ---------- Defect tables ---------------------------------------------------------------------------------
+
+namespace {
+
+// Singleton class that manages the schema and keys of tables of defects
+class DefectTableKeys {
+public:
+    afw::table::Schema schema;
+    afw::table::Key<int> x0;
+    afw::table::Key<int> y0;
+    afw::table::Key<int> width;
+    afw::table::Key<int> height;
+
+    static DefectTableKeys const &get() {
+        static DefectTableKeys const instance;
+        return instance;
+    }
+
+    // No copying
+    DefectTableKeys(const DefectTableKeys &) = delete;
+    DefectTableKeys &operator=(const DefectTableKeys &) = delete;
+
+    // No moving
+    DefectTableKeys(DefectTableKeys &&) = delete;
+    DefectTableKeys &operator=(DefectTableKeys &&) = delete;
+
+private:
+    DefectTableKeys()
+            : schema(),
+              x0(schema.addField<int>("x0", "first column of the defect", "pixel")),
+              y0(schema.addField<int>("y0", "first row of the defect", "pixel")),
+              width(schema.addField<int>("width", "number of columns in the defect", "pixel")),
+              height(schema.addField<int>("height", "number of rows in the defect", "pixel")) {
+        schema.getCitizen().markPersistent();
+    }
+};
 
-        data = alloca(ndata * sizeof(PIX));
-        for (i = i0; i <= i1; i++) {
-            data[i - i0] = reg->ROWS[rowc][i];
+}  // namespace
+
+void writeDefects(std::string const &fileName, std::vector<Defect::Ptr> const &badList) {
+    DefectTableKeys const &keys = DefectTableKeys::get();
+    afw::table::BaseCatalog catalog(keys.schema);
+    catalog.reserve(badList.size());
+    for (Defect::Ptr const &defect : badList) {
+        geom::Box2I const bbox = defect->getBBox();
+        PTR(afw::table::BaseRecord) record = catalog.addNew();
+        record->set(keys.x0, bbox.getMinX());
+        record->set(keys.y0, bbox.getMinY());
+        record->set(keys.width, bbox.getWidth());
+        record->set(keys.height, bbox.getHeight());
+    }
+    catalog.writeFits(fileName);
+}
+
+std::vector<Defect::Ptr> readDefects(std::string const &fileName, int hdu) {
+    afw::table::BaseCatalog const catalog = afw::table::BaseCatalog::readFits(fileName, hdu);
+    // Look the columns up by name, so that tables written by other means may be read too
+    afw::table::Schema const schema = catalog.getSchema();
+    afw::table::Key<int> const x0 = schema.find<int>("x0").key;
+    afw::table::Key<int> const y0 = schema.find<int>("y0").key;
+    afw::table::Key<int> const width = schema.find<int>("width").key;
+    afw::table::Key<int> const height = schema.find<int>("height").key;
+
+    std::vector<Defect::Ptr> badList;
+    badList.reserve(catalog.size());
+    for (afw::table::BaseCatalog::const_iterator i = catalog.begin(); i != catalog.end(); ++i) {
+        int const w = i->get(width);
+        int const h = i->get(height);
+        if (w <= 0 || h <= 0) {
+            throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                              (boost::format("Defect %d in %s is empty (%dx%d)") % badList.size() %
+                               fileName % w % h)
+                                      .str());
         }
-        val = &data[colc - i0];
-    } else {
-        for (z1 = rowc - 1; z1 >= 0; z1--) {
-            if (!phPixIntersectMask(badmask, colc, z1)) {
+        badList.push_back(std::make_shared<Defect>(
+                geom::Box2I(geom::Point2I(i->get(x0), i->get(y0)), geom::Extent2I(w, h))));
+    }
+
+    return badList;
+}
+
+/*****************************************************************************/
+
+namespace {
+
+int const ndatamax = 40;  // largest allowable run of bad pixels (including 2 good pixels at each end)
+
+/*
+ * A single row of up to ndatamax pixels, providing the parts of the Image interface used by do_defects
+ */
+template <typename PixelT>
+class RowBuffer {
+public:
+    typedef PixelT Pixel;
+    typedef PixelT *x_iterator;
+
+    explicit RowBuffer(int const width) : _width(width) { assert(width <= ndatamax); }
+
+    int getWidth() const { return _width; }
+    x_iterator row_begin(int) { return _data; }
+
+private:
+    PixelT _data[ndatamax];
+    int _width;
+};
+
+/*
+ * Interpolate over single pixels in an image, as interp::singlePixel
+ *
+ * The pointers to the image's pixels are looked up once, so many pixels may be processed cheaply
+ */
+template <typename MaskedImageT>
+class SinglePixelInterpolator {
+public:
+    typedef typename MaskedImageT::Image::Pixel ImagePixel;
+    typedef typename MaskedImageT::Mask::Pixel MaskPixel;
+
+    SinglePixelInterpolator(MaskedImageT const &mimage, MaskPixel const badMask)
+            : _x0(mimage.getX0()),
+              _y0(mimage.getY0()),
+              _ncol(mimage.getWidth()),
+              _nrow(mimage.getHeight()),
+              _badMask(badMask) {
+        auto const imageArray = mimage.getImage()->getArray();
+        auto const maskArray = mimage.getMask()->getArray();
+        _imageData = imageArray.getData();
+        _imageStride = imageArray.getStrides()[0];
+        _maskData = maskArray.getData();
+        _maskStride = maskArray.getStrides()[0];
+    }
+
+    std::pair<bool, ImagePixel> operator()(int const x, int const y, bool const horizontal,
+                                           double const minval) const {
+        std::pair<bool, ImagePixel> const failure(false, std::numeric_limits<ImagePixel>::min());
+
+        int const ix = x - _x0;  // position in the image's pixel coordinates
+        int const iy = y - _y0;
+        if (ix < 0 || ix >= _ncol || iy < 0 || iy >= _nrow) {
+            return failure;
+        }
+        /*
+         * Set up to walk along the row or column through (ix, iy)
+         */
+        int const n = horizontal ? _ncol : _nrow;  // number of pixels in the row or column
+        int const c = horizontal ? ix : iy;        // index of (ix, iy) in the row or column
+        int const imageStride = horizontal ? 1 : _imageStride;  // step between pixels
+        int const maskStride = horizontal ? 1 : _maskStride;
+        ImagePixel const *const data = horizontal ? _imageData + iy * _imageStride : _imageData + ix;
+        MaskPixel const *const mask = horizontal ? _maskData + iy * _maskStride : _maskData + ix;
+        /*
+         * Find the range of bad pixels [z1, z2] that includes c
+         */
+        int z1 = c - 1;
+        for (; z1 >= 0; z1--) {
+            if (!(mask[z1 * maskStride] & _badMask)) {
                 break;
             }
         }
         z1++;
 
-        for (z2 = rowc + 1; z2 < nrow; z2++) {
-            if (!phPixIntersectMask(badmask, colc, z2)) {
+        int z2 = c + 1;
+        for (; z2 < n; z2++) {
+            if (!(mask[z2 * maskStride] & _badMask)) {
                 break;
             }
         }
         z2--;
 
-        i0 = (z1 > 2) ? z1 - 2 : 0;               /* origin of available required data */
-        i1 = (z2 < nrow - 2) ? z2 + 2 : nrow - 1; /* end of "      "   "    "  */
-
-        if (i0 < 2 || i1 >= ncol - 2) { /* interpolation will fail */
-            return (-1);                /* failure */
+        int const i0 = z1 - 2;  // origin of required data
+        int const i1 = z2 + 2;  // end of   "        "
+        if (i0 < 0 || i1 >= n) {  // interpolation will fail
+            return failure;
         }
 
-        ndata = (i1 - i0 + 1);
+        int const ndata = i1 - i0 + 1;
         if (ndata > ndatamax) {
-            return (-1); /* failure */
+            return failure;
         }
 
-        data = alloca(ndata * sizeof(PIX));
-        for (i = i0; i <= i1; i++) {
-            data[i - i0] = reg->ROWS[i][colc];
+        RowBuffer<ImagePixel> buffer(ndata);
+        typename RowBuffer<ImagePixel>::x_iterator const out = buffer.row_begin(0);
+        for (int i = i0; i <= i1; i++) {
+            out[i - i0] = data[i * imageStride];
         }
-        val = &data[rowc - i0];
+
+        DefectRun defect = {z1 - i0, z2 - i0, Defect::MIDDLE, 0};
+        classify_defects(&defect, 1, ndata);
+
+        long nFallback = 0;
+        do_defects(&defect, &defect + 1, 0, buffer, static_cast<ImagePixel>(minval), 0.0, false, nUseInterp,
+                   nFallback);
+
+        return std::make_pair(true, out[c - i0]);
     }
 
-    defect.x1 = z1 - i0;
-    defect.x2 = z2 - i0;
-    classify_defects(&defect, 1, ndata);
-    do_defect(&defect, 1, data, ndata, minval);
+private:
+    int _x0, _y0;
+    int _ncol, _nrow;
+    MaskPixel _badMask;
+    ImagePixel const *_imageData;  // the image's pixels
+    int _imageStride;              // distance between the image's rows
+    MaskPixel const *_maskData;    // the mask's pixels
+    int _maskStride;               // distance between the mask's rows
+};
 
-    return (*val);
-#endif
+}  // namespace
+
+/**
+ *
+ * Return a boolean status (true: interpolation is OK) and the interpolated value for a pixel,
+ * ignoring pixels given by badMask
+ *
+ * Interpolation can either be vertical or horizontal; the pixel, and all its neighbours along the row
+ * (or column) with any of the bits in badMask set, are interpolated over using the same LPC
+ * coefficients as interpolateOverDefects.  Interpolation fails if there are fewer than two good pixels
+ * on either side of the bad ones before the edge of the image, or if the run of bad pixels is too long.
+ */
+template <typename MaskedImageT>
+std::pair<bool, typename MaskedImageT::Image::Pixel> interp::singlePixel(
+        int x,                        ///< column coordinate of the pixel in question (parent coordinates)
+        int y,                        ///< row coordinate of the pixel in question (parent coordinates)
+        MaskedImageT const &image,    ///< in this image
+        bool horizontal,              ///< interpolate horizontally?
+        double minval,                ///< minimum acceptable value
+        typename MaskedImageT::Mask::Pixel badMask  ///< bits identifying bad pixels
+) {
+    return SinglePixelInterpolator<MaskedImageT>(image, badMask)(x, y, horizontal, minval);
+}
+
+/**
+ * Interpolate over a set of pixels, as singlePixel
+ *
+ * The pixels are interpolated independently, using the image's values (i.e. the values estimated for
+ * earlier positions are not used for later ones).
+ */
+template <typename MaskedImageT>
+std::vector<std::pair<bool, typename MaskedImageT::Image::Pixel>> interp::singlePixels(
+        std::vector<geom::Point2I> const &positions,  ///< positions of the pixels (parent coordinates)
+        MaskedImageT const &image,                    ///< in this image
+        bool horizontal,                              ///< interpolate horizontally?
+        double minval,                                ///< minimum acceptable value
+        typename MaskedImageT::Mask::Pixel badMask    ///< bits identifying bad pixels
+) {
+    SinglePixelInterpolator<MaskedImageT> const interpolator(image, badMask);
+
+    std::vector<std::pair<bool, typename MaskedImageT::Image::Pixel>> values;
+    values.reserve(positions.size());
+    for (geom::Point2I const &position : positions) {
+        values.push_back(interpolator(position.getX(), position.getY(), horizontal, minval));
+    }
 
-    return std::make_pair(false, std::numeric_limits<typename MaskedImageT::Image::Pixel>::min());
+    return values;
 }
 
 /************************************************************************************************************/
@@ -2233,21 +3071,45 @@ typedef float ImagePixel;
 
 template void interpolateOverDefects(afw::image::MaskedImage<ImagePixel, afw::image::MaskPixel> &image,
                                      afw::detection::Psf const &, std::vector<Defect::Ptr> &badList, double,
-                                     bool);
+                                     bool, int, double);
+template DefectInterpolationStatistics interpolateOverMask(
+        afw::image::MaskedImage<ImagePixel, afw::image::MaskPixel> &image, afw::image::MaskPixel, double,
+        bool, int, double);
+template DefectInterpolationStatistics DefectPlan::apply(
+        afw::image::MaskedImage<ImagePixel, afw::image::MaskPixel> &image, double, bool, int) const;
+template std::vector<DefectInterpolationStatistics> DefectPlan::applyBatch(
+        std::vector<std::shared_ptr<afw::image::MaskedImage<ImagePixel, afw::image::MaskPixel>>> const &,
+        double, bool, int) const;
 template std::pair<bool, ImagePixel> interp::singlePixel(
         int x, int y, afw::image::MaskedImage<ImagePixel, afw::image::MaskPixel> const &image,
-        bool horizontal, double minval);
+        bool horizontal, double minval, afw::image::MaskPixel badMask);
+template std::vector<std::pair<bool, ImagePixel>> interp::singlePixels(
+        std::vector<geom::Point2I> const &positions,
+        afw::image::MaskedImage<ImagePixel, afw::image::MaskPixel> const &image, bool horizontal,
+        double minval, afw::image::MaskPixel badMask);
 //
 // Why do we need double images?
 //
 #if 1
 template void interpolateOverDefects(afw::image::MaskedImage<double, afw::image::MaskPixel> &image,
                                      afw::detection::Psf const &, std::vector<Defect::Ptr> &badList, double,
-                                     bool);
+                                     bool, int, double);
+template DefectInterpolationStatistics interpolateOverMask(
+        afw::image::MaskedImage<double, afw::image::MaskPixel> &image, afw::image::MaskPixel, double, bool,
+        int, double);
+template DefectInterpolationStatistics DefectPlan::apply(
+        afw::image::MaskedImage<double, afw::image::MaskPixel> &image, double, bool, int) const;
+template std::vector<DefectInterpolationStatistics> DefectPlan::applyBatch(
+        std::vector<std::shared_ptr<afw::image::MaskedImage<double, afw::image::MaskPixel>>> const &,
+        double, bool, int) const;
 
 template std::pair<bool, double> interp::singlePixel(
         int x, int y, afw::image::MaskedImage<double, afw::image::MaskPixel> const &image, bool horizontal,
-        double minval);
+        double minval, afw::image::MaskPixel badMask);
+template std::vector<std::pair<bool, double>> interp::singlePixels(
+        std::vector<geom::Point2I> const &positions,
+        afw::image::MaskedImage<double, afw::image::MaskPixel> const &image, bool horizontal, double minval,
+        afw::image::MaskPixel badMask);
 
 #endif
 // \endcond
@@ -155,6 +155,18 @@ WarpedPsf::WarpedPsf(PTR(afw::detection::Psf const) undistortedPsf,
     _init();
 }
 
+WarpedPsf::WarpedPsf(PTR(afw::detection::Psf const) undistortedPsf,
+                     PTR(afw::geom::TransformPoint2ToPoint2 const) distortion,
+                     PTR(afw::geom::TransformPoint2ToPoint2 const) inverseDistortion,
+                     CONST_PTR(afw::math::WarpingControl) control)
+        : ImagePsf(false),
+          _undistortedPsf(undistortedPsf),
+          _distortion(distortion),
+          _inverseDistortion(inverseDistortion),
+          _warpingControl(control) {
+    _init();
+}
+
 void WarpedPsf::_init() {
     if (!_undistortedPsf) {
         throw LSST_EXCEPT(pex::exceptions::LogicError,
@@ -163,6 +175,9 @@ void WarpedPsf::_init() {
     if (!_distortion) {
         throw LSST_EXCEPT(pex::exceptions::LogicError, "Transform passed to WarpedPsf must not be None/NULL");
     }
+    if (!_inverseDistortion) {
+        _inverseDistortion = _distortion->inverted();
+    }
     if (!_warpingControl) {
         throw LSST_EXCEPT(pex::exceptions::LogicError,
                           "WarpingControl passed to WarpedPsf must not be None/NULL");
@@ -174,7 +189,8 @@ geom::Point2D WarpedPsf::getAveragePosition() const {
 }
 
 PTR(afw::detection::Psf) WarpedPsf::clone() const {
-    return std::make_shared<WarpedPsf>(_undistortedPsf->clone(), _distortion, _warpingControl);
+    return std::make_shared<WarpedPsf>(_undistortedPsf->clone(), _distortion, _inverseDistortion,
+                                       _warpingControl);
 }
 
 PTR(afw::detection::Psf) WarpedPsf::resized(int width, int height) const {
@@ -186,7 +202,7 @@ PTR(afw::detection::Psf) WarpedPsf::resized(int width, int height) const {
 
 PTR(afw::detection::Psf::Image)
 WarpedPsf::doComputeKernelImage(geom::Point2D const &position, afw::image::Color const &color) const {
-    geom::AffineTransform t = afw::geom::linearizeTransform(*_distortion->inverted(), position);
+    geom::AffineTransform t = afw::geom::linearizeTransform(*_inverseDistortion, position);
     geom::Point2D tp = t(position);
 
     PTR(Image) im = _undistortedPsf->computeKernelImage(tp, color);
@@ -215,7 +231,7 @@ WarpedPsf::doComputeKernelImage(geom::Point2D const &position, afw::image::Color
 }
 
 geom::Box2I WarpedPsf::doComputeBBox(geom::Point2D const &position, afw::image::Color const &color) const {
-    geom::AffineTransform t = afw::geom::linearizeTransform(*_distortion->inverted(), position);
+    geom::AffineTransform t = afw::geom::linearizeTransform(*_inverseDistortion, position);
     geom::Point2D tp = t(position);
     geom::Box2I bboxUndistorted = _undistortedPsf->computeBBox(tp, color);
     geom::Box2I ret =
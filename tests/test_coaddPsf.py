@@ -22,6 +22,8 @@
 #
 import unittest
 
+import numpy as np
+
 import lsst.geom
 import lsst.afw.geom as afwGeom
 import lsst.afw.math as afwMath
@@ -480,6 +482,131 @@ class CoaddPsfTest(lsst.utils.tests.TestCase):
             coaddPsf.computeKernelImage()
         self.assertIn("id=%d" % (badId,), str(cm.exception))
 
+    def testInputIndex(self):
+        """Test that the inputs used at each point are those that contain it
+
+        The CoaddPsf's spatial index of its inputs must give the same result as
+        ExposureCatalog.subsetContaining, so a CoaddPsf made from just the inputs
+        containing a point must give the same image there.
+        """
+        rng = np.random.RandomState(12345)
+        for i in range(20):
+            record = self.mycatalog.addNew()
+            record.setPsf(measAlg.DoubleGaussianPsf(21, 21, rng.uniform(1.0, 3.0), 1.00, 0.0))
+            crpix = lsst.geom.PointD(*rng.uniform(-500, 1500, size=2))
+            cdMatrix = afwGeom.makeCdMatrix(scale=5.55555555e-05*lsst.geom.degrees,
+                                            orientation=rng.uniform(0, 360)*lsst.geom.degrees)
+            record.setWcs(afwGeom.makeSkyWcs(crpix=crpix, crval=self.crval, cdMatrix=cdMatrix))
+            record['weight'] = rng.uniform(0.5, 2.0)
+            record['id'] = i
+            record.setBBox(lsst.geom.Box2I(lsst.geom.Point2I(0, 0), lsst.geom.Extent2I(800, 600)))
+            if i % 3 == 0:
+                # include the PSF's average position, (0, 0), so that every subset has a valid one
+                record.setValidPolygon(afwGeom.Polygon(lsst.geom.Box2D(lsst.geom.Point2D(-10, -10),
+                                                                       lsst.geom.Extent2D(500, 300))))
+
+        coaddPsf = measAlg.CoaddPsf(self.mycatalog, self.wcsref)
+        nFound = 0
+        for x, y in rng.uniform(-1000, 3000, size=(100, 2)):
+            point = lsst.geom.Point2D(x, y)
+            subset = self.mycatalog.subsetContaining(point, self.wcsref, True)
+            if len(subset) == 0:
+                with self.assertRaises(pexExceptions.InvalidParameterError):
+                    coaddPsf.computeKernelImage(point)
+                with self.assertRaises(pexExceptions.InvalidParameterError):
+                    coaddPsf.computeBBox(point)
+                continue
+            nFound += 1
+            subsetPsf = measAlg.CoaddPsf(subset, self.wcsref)
+            self.assertImagesEqual(coaddPsf.computeKernelImage(point), subsetPsf.computeKernelImage(point))
+            self.assertEqual(coaddPsf.computeBBox(point), subsetPsf.computeBBox(point))
+        self.assertGreater(nFound, 10)
+
+    def testComponentCache(self):
+        """Test that reusing the inputs' transforms doesn't change the results"""
+        for i in range(4):
+            record = self.mycatalog.addNew()
+            record.setPsf(measAlg.DoubleGaussianPsf(31, 31, 2.0 + 0.5*i, 1.00, 0.0))
+            crpix = lsst.geom.PointD(1000 - 10.0*i, 1000 + 20.0*i)
+            record.setWcs(afwGeom.makeSkyWcs(crpix=crpix, crval=self.crval, cdMatrix=self.cdMatrix))
+            record['weight'] = 1.0 + i
+            record['id'] = i
+            record.setBBox(lsst.geom.Box2I(lsst.geom.Point2I(0, 0), lsst.geom.Extent2I(2000, 2000)))
+
+        points = [lsst.geom.Point2D(1000, 1000), lsst.geom.Point2D(1200.5, 950.25),
+                  lsst.geom.Point2D(500, 1500)]
+        expected = [(measAlg.CoaddPsf(self.mycatalog, self.wcsref).computeKernelImage(point),
+                     measAlg.CoaddPsf(self.mycatalog, self.wcsref).computeBBox(point)) for point in points]
+
+        coaddPsf = measAlg.CoaddPsf(self.mycatalog, self.wcsref)
+        for psf in [coaddPsf, coaddPsf, coaddPsf.clone()]:
+            for point, (image, bbox) in zip(points, expected):
+                self.assertEqual(psf.computeBBox(point), bbox)
+                self.assertImagesEqual(psf.computeKernelImage(point), image)
+
+    def testThreads(self):
+        """Test that warping the inputs in parallel doesn't change the results"""
+        sharedPsf = measAlg.DoubleGaussianPsf(31, 31, 2.5, 1.00, 0.0)
+        for i in range(6):
+            record = self.mycatalog.addNew()
+            # the last two inputs share a Psf, which forces warping one input at a time
+            record.setPsf(measAlg.DoubleGaussianPsf(31, 31, 2.0 + 0.25*i, 1.00, 0.0) if i < 4 else sharedPsf)
+            crpix = lsst.geom.PointD(1000 - 10.0*i, 1000 + 20.0*i)
+            record.setWcs(afwGeom.makeSkyWcs(crpix=crpix, crval=self.crval, cdMatrix=self.cdMatrix))
+            record['weight'] = 1.0 + i
+            record['id'] = i
+            record.setBBox(lsst.geom.Box2I(lsst.geom.Point2I(0, 0), lsst.geom.Extent2I(2000, 2000)))
+
+        points = [lsst.geom.Point2D(1000, 1000), lsst.geom.Point2D(1200.5, 950.25)]
+        for catalog in [self.mycatalog[:4], self.mycatalog]:
+            expected = [measAlg.CoaddPsf(catalog, self.wcsref).computeKernelImage(point) for point in points]
+            ctrl = measAlg.CoaddPsfControl(nThreads=4)
+            for psf in [measAlg.CoaddPsf(catalog, self.wcsref, ctrl), measAlg.CoaddPsf(catalog, self.wcsref)]:
+                psf.setNumThreads(4)
+                self.assertEqual(psf.getNumThreads(), 4)
+                for point, image in zip(points, expected):
+                    self.assertImagesEqual(psf.computeKernelImage(point), image)
+                    self.assertImagesEqual(psf.clone().computeKernelImage(point), image)
+
+    def testComputeKernelImages(self):
+        """Test computing the kernel images at many positions at once"""
+        for i in range(3):
+            record = self.mycatalog.addNew()
+            record.setPsf(measAlg.DoubleGaussianPsf(21 + 10*i, 21 + 10*i, 1.5 + 0.5*i, 1.00, 0.0))
+            # input i covers 300*i <= x < 2000 + 300*i in the coadd
+            crpix = lsst.geom.PointD(1000 - 300.0*i, 1000)
+            record.setWcs(afwGeom.makeSkyWcs(crpix=crpix, crval=self.crval, cdMatrix=self.cdMatrix))
+            record['weight'] = 1.0 + i
+            record['id'] = i
+            record.setBBox(lsst.geom.Box2I(lsst.geom.Point2I(0, 0), lsst.geom.Extent2I(2000, 2000)))
+
+        # the positions have different sets of inputs, and so images of different sizes; several share
+        # their inputs, and one group is too big to be computed in a single batch
+        points = [lsst.geom.Point2D(x, y) for x, y in [(1000, 1000), (100, 500), (2400.5, 1200.25),
+                                                        (400, 1000), (1000.5, 999.5), (2200, 300),
+                                                        (100, 500)]]
+        points += [lsst.geom.Point2D(1200 + 0.37*j, 800 - 0.21*j) for j in range(300)]
+        for nThreads, useCache in ((1, False), (2, False), (1, True)):
+            coaddPsf = measAlg.CoaddPsf(self.mycatalog, self.wcsref)
+            coaddPsf.setNumThreads(nThreads)
+            if useCache:
+                coaddPsf.setKernelImageCache(10.0, 100.0)
+            stack = coaddPsf.computeKernelImages(points)
+            self.assertEqual(stack.images.shape,
+                             (len(points), stack.bbox.getHeight(), stack.bbox.getWidth()))
+            for point, array in zip(points, stack.images):
+                image = coaddPsf.computeKernelImage(point)
+                self.assertTrue(stack.bbox.contains(image.getBBox()))
+                expected = np.zeros_like(array)
+                y0, x0 = image.getY0() - stack.bbox.getMinY(), image.getX0() - stack.bbox.getMinX()
+                expected[y0:y0 + image.getHeight(), x0:x0 + image.getWidth()] = image.array
+                np.testing.assert_array_equal(array, expected)
+            self.assertLess(coaddPsf.computeBBox(points[1]).getWidth(), stack.bbox.getWidth())
+
+        self.assertEqual(coaddPsf.computeKernelImages([]).images.shape[0], 0)
+        with self.assertRaises(pexExceptions.InvalidParameterError):
+            coaddPsf.computeKernelImages(points + [lsst.geom.Point2D(-500, 1000)])
+
 
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass
@@ -0,0 +1,123 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE CoaddPsfCaching
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-variable"
+#include "boost/test/unit_test.hpp"
+#pragma clang diagnostic pop
+
+#include <memory>
+
+#include "ndarray/eigen.h"
+#include "lsst/geom/Angle.h"
+#include "lsst/geom/Box.h"
+#include "lsst/geom/Point.h"
+#include "lsst/geom/SpherePoint.h"
+#include "lsst/afw/geom/SkyWcs.h"
+#include "lsst/afw/table/Exposure.h"
+#include "lsst/afw/detection/Psf.h"
+#include "lsst/meas/algorithms/CoaddPsf.h"
+#include "lsst/meas/algorithms/DoubleGaussianPsf.h"
+
+using namespace lsst::afw::detection;
+using namespace lsst::afw::image;
+using namespace lsst::meas::algorithms;
+
+namespace {
+
+// Make a CoaddPsf of three slightly offset inputs
+std::shared_ptr<CoaddPsf> makeCoaddPsf(CoaddPsfControl const &ctrl) {
+    lsst::afw::table::Schema schema = lsst::afw::table::ExposureTable::makeMinimalSchema();
+    lsst::afw::table::Key<double> weightKey = schema.addField<double>("weight", "Coadd weight");
+    lsst::afw::table::ExposureCatalog catalog(schema);
+
+    lsst::geom::SpherePoint const crval(0.0 * lsst::geom::degrees, 0.0 * lsst::geom::degrees);
+    Eigen::Matrix2d const cdMatrix = lsst::afw::geom::makeCdMatrix(0.2 * lsst::geom::arcseconds);
+    for (int i = 0; i < 3; ++i) {
+        std::shared_ptr<lsst::afw::table::ExposureRecord> record = catalog.addNew();
+        record->setPsf(std::make_shared<DoubleGaussianPsf>(21, 21, 1.5 + 0.5 * i, 3.0, 0.1));
+        record->setWcs(lsst::afw::geom::makeSkyWcs(lsst::geom::Point2D(1000 + 10 * i, 1000 - 5 * i), crval,
+                                                   cdMatrix));
+        record->setBBox(lsst::geom::Box2I(lsst::geom::Point2I(0, 0), lsst::geom::Extent2I(2000, 2000)));
+        record->set(weightKey, 1.0 + i);
+    }
+    auto const coaddWcs = lsst::afw::geom::makeSkyWcs(lsst::geom::Point2D(1000, 1000), crval, cdMatrix);
+
+    return std::make_shared<CoaddPsf>(catalog, *coaddWcs, ctrl);
+}
+
+void checkStatistics(CoaddPsf const &psf, long nHit, long nMiss, long nEvicted, std::size_t nEntry) {
+    CoaddPsfCacheStatistics const stats = psf.getKernelImageCacheStatistics();
+    BOOST_CHECK_EQUAL(stats.nHit, nHit);
+    BOOST_CHECK_EQUAL(stats.nMiss, nMiss);
+    BOOST_CHECK_EQUAL(stats.nEvicted, nEvicted);
+    BOOST_CHECK_EQUAL(stats.nEntry, nEntry);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(CoaddPsfNoKernelCache) {
+    auto psf = makeCoaddPsf(CoaddPsfControl());
+    psf->computeKernelImage(lsst::geom::Point2D(1001, 1001), Color(), Psf::INTERNAL);
+    psf->computeKernelImage(lsst::geom::Point2D(1003, 1002), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 0, 0, 0, 0);
+    BOOST_CHECK_EQUAL(psf->getKernelImageCacheStatistics().memory, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(CoaddPsfKernelCache) {
+    CoaddPsfControl ctrl;
+    ctrl.kernelCacheCellSize = 10.0;
+    ctrl.kernelCacheMaxMemory = 1.0;
+    auto psf = makeCoaddPsf(ctrl);
+
+    PTR(Psf::Image) im1 = psf->computeKernelImage(lsst::geom::Point2D(1001, 1001), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 0, 1, 0, 1);
+    BOOST_CHECK_GT(psf->getKernelImageCacheStatistics().memory, 0u);
+    // The same position is answered by the afw Psf cache, and never reaches ours
+    PTR(Psf::Image) im2 = psf->computeKernelImage(lsst::geom::Point2D(1001, 1001), Color(), Psf::INTERNAL);
+    BOOST_CHECK(im1 == im2);
+    checkStatistics(*psf, 0, 1, 0, 1);
+    // A different position in the same cell is answered by our cache, with a copy of the same image
+    PTR(Psf::Image) im3 = psf->computeKernelImage(lsst::geom::Point2D(1003.5, 1008), Color(), Psf::INTERNAL);
+    BOOST_CHECK(im1 != im3);
+    BOOST_CHECK_EQUAL(im1->getBBox(), im3->getBBox());
+    BOOST_CHECK_EQUAL(ndarray::asEigenMatrix(im1->getArray()), ndarray::asEigenMatrix(im3->getArray()));
+    BOOST_CHECK_EQUAL(psf->computeBBox(lsst::geom::Point2D(1003.5, 1008)), im3->getBBox());
+    checkStatistics(*psf, 1, 1, 0, 1);
+    // A new cell
+    psf->computeKernelImage(lsst::geom::Point2D(1015, 1001), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 1, 2, 0, 2);
+    // Back to the first cell, which is still cached
+    psf->computeKernelImage(lsst::geom::Point2D(1003.5, 1008), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 2, 2, 0, 2);
+
+    // Clones have their own cache, with the same configuration
+    PTR(Psf) clone = psf->clone();
+    checkStatistics(dynamic_cast<CoaddPsf const &>(*clone), 0, 0, 0, 0);
+    clone->computeKernelImage(lsst::geom::Point2D(1001, 1001), Color(), Psf::INTERNAL);
+    checkStatistics(dynamic_cast<CoaddPsf const &>(*clone), 0, 1, 0, 1);
+}
+
+BOOST_AUTO_TEST_CASE(CoaddPsfKernelCacheEviction) {
+    CoaddPsfControl ctrl;
+    ctrl.kernelCacheCellSize = 10.0;
+    ctrl.kernelCacheMaxMemory = 1.0;
+    auto psf = makeCoaddPsf(ctrl);
+    psf->computeKernelImage(lsst::geom::Point2D(1001, 1001), Color(), Psf::INTERNAL);
+    std::size_t const memory = psf->getKernelImageCacheStatistics().memory;
+
+    // Room for only one image
+    ctrl.kernelCacheMaxMemory = 1.5 * memory / (1024 * 1024);
+    psf = makeCoaddPsf(ctrl);
+    psf->computeKernelImage(lsst::geom::Point2D(1001, 1001), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 0, 1, 0, 1);
+    psf->computeKernelImage(lsst::geom::Point2D(1015, 1001), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 0, 2, 1, 1);
+    psf->computeKernelImage(lsst::geom::Point2D(1002, 1001), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 0, 3, 2, 1);
+    BOOST_CHECK_EQUAL(psf->getKernelImageCacheStatistics().memory, memory);
+
+    // The cache may be turned off
+    psf->setKernelImageCache(10.0, 0.0);
+    psf->computeKernelImage(lsst::geom::Point2D(1003, 1001), Color(), Psf::INTERNAL);
+    checkStatistics(*psf, 0, 0, 0, 0);
+}
@@ -24,6 +24,8 @@ import os
 import sys
 import unittest
 
+import numpy as np
+
 import lsst.geom
 import lsst.afw.image as afwImage
 import lsst.afw.math as afwMath
@@ -31,6 +33,7 @@ import lsst.log.utils as logUtils
 import lsst.meas.algorithms as algorithms
 import lsst.meas.algorithms.defects as defects
 import lsst.pex.config as pexConfig
+import lsst.pex.exceptions
 import lsst.utils
 import lsst.utils.tests
 
@@ -181,6 +184,427 @@ class CosmicRayNullTestCase(unittest.TestCase):
         self.assertEqual(len(crs), 0, "Found %d CRs in empty image" % len(crs))
 
 
+class CosmicRayThreadsTestCase(lsst.utils.tests.TestCase):
+    """Test that searching for CRs in parallel gives the same answers as a serial search."""
+
+    def setUp(self):
+        self.FWHM = 5                   # pixels
+        self.psf = algorithms.DoubleGaussianPsf(29, 29, self.FWHM/(2*math.sqrt(2*math.log(2))))
+
+        width, height = 300, 201
+        self.mi = afwImage.MaskedImageF(width, height)
+        rng = np.random.RandomState(12345)
+        self.mi.getImage().getArray()[:] = rng.normal(0.0, 10.0, (height, width))
+        self.mi.getVariance().set(100.0)
+        #
+        # Add CRs; some of them cross the boundaries between the bands used by the threaded code
+        #
+        ima = self.mi.getImage().getArray()
+        for y in (49, 50, 99, 100, 149, 150):
+            x = rng.randint(5, width - 5)
+            ima[y - 3:y + 4, x] += 1000.0
+            ima[y, x - 2:x + 3] += 500.0
+        for i in range(100):
+            x, y = rng.randint(2, width - 2), rng.randint(2, height - 2)
+            ima[y, x] += rng.uniform(300, 3000)
+
+    def tearDown(self):
+        del self.psf
+        del self.mi
+
+    def testThreads(self):
+        results = []
+        for nThreads in (1, 2, 4, 7):
+            mi = afwImage.MaskedImageF(self.mi, True)
+            crConfig = algorithms.FindCosmicRaysConfig()
+            crConfig.nThreads = nThreads
+            crs = algorithms.findCosmicRays(mi, self.psf, 0.0, pexConfig.makePolicy(crConfig))
+            results.append((nThreads, mi, crs))
+
+        nThreads0, mi0, crs0 = results[0]
+        self.assertGreater(len(crs0), 0)
+        for nThreads, mi, crs in results[1:]:
+            self.assertEqual(len(crs), len(crs0), "nThreads=%d" % nThreads)
+            for cr, cr0 in zip(crs, crs0):
+                self.assertEqual(cr.getSpans(), cr0.getSpans())
+            self.assertMaskedImagesEqual(mi, mi0)
+
+
+class CosmicRayGrowFrontierTestCase(lsst.utils.tests.TestCase):
+    """Test growing CRs from the pixels added in the previous iteration."""
+
+    def setUp(self):
+        self.psf = algorithms.DoubleGaussianPsf(29, 29, 2.0)
+
+        width, height = 200, 150
+        self.mi = afwImage.MaskedImageF(width, height)
+        rng = np.random.RandomState(314159)
+        self.mi.getImage().getArray()[:] = rng.normal(0.0, 10.0, (height, width))
+        self.mi.getVariance().set(100.0)
+        #
+        # Add some long CRs with faint wings, which need several iterations to grow
+        #
+        ima = self.mi.getImage().getArray()
+        for y in (30, 75, 120):
+            x = rng.randint(20, width - 60)
+            ima[y, x:x + 40] += 2000.0
+            ima[y - 1, x:x + 40] += 100.0
+            ima[y + 1, x:x + 40] += 100.0
+        for i in range(50):
+            x, y = rng.randint(2, width - 2), rng.randint(2, height - 2)
+            ima[y, x] += rng.uniform(300, 3000)
+
+    def tearDown(self):
+        del self.psf
+        del self.mi
+
+    def testGrowFrontier(self):
+        crConfig = algorithms.FindCosmicRaysConfig()
+        mi0 = afwImage.MaskedImageF(self.mi, True)
+        crs0 = algorithms.findCosmicRays(mi0, self.psf, 0.0, pexConfig.makePolicy(crConfig))
+
+        crConfig.growFrontier = True
+        mi = afwImage.MaskedImageF(self.mi, True)
+        crs = algorithms.findCosmicRays(mi, self.psf, 0.0, pexConfig.makePolicy(crConfig))
+
+        self.assertGreater(len(crs0), 0)
+        self.assertEqual(len(crs), len(crs0))
+        for cr in crs:
+            self.assertTrue(any(cr.getSpans().overlaps(cr0.getSpans()) for cr0 in crs0))
+
+        crBit = mi.getMask().getPlaneBitMask("CR")
+        maskArr = mi.getMask().getArray()
+        for cr in crs:
+            for span in cr.getSpans():
+                self.assertTrue(np.all(maskArr[span.getY(), span.getX0():span.getX1() + 1] & crBit))
+
+
+class CosmicRayStatisticsTestCase(lsst.utils.tests.TestCase):
+    """Test the timings and counts returned by findCosmicRays."""
+
+    def setUp(self):
+        self.psf = algorithms.DoubleGaussianPsf(29, 29, 2.0)
+
+        width, height = 150, 100
+        self.mi = afwImage.MaskedImageF(width, height)
+        rng = np.random.RandomState(271828)
+        self.mi.getImage().getArray()[:] = rng.normal(0.0, 10.0, (height, width))
+        self.mi.getVariance().set(100.0)
+        ima = self.mi.getImage().getArray()
+        for i in range(30):
+            x, y = rng.randint(2, width - 2), rng.randint(2, height - 2)
+            ima[y, x] += rng.uniform(300, 3000)
+
+    def tearDown(self):
+        del self.psf
+        del self.mi
+
+    def testStatistics(self):
+        crConfig = algorithms.FindCosmicRaysConfig()
+        stats = algorithms.CosmicRayStatistics()
+        crs = algorithms.findCosmicRays(self.mi, self.psf, 0.0, pexConfig.makePolicy(crConfig), stats=stats)
+
+        self.assertGreater(len(crs), 0)
+        self.assertEqual(stats.nCr, len(crs))
+        self.assertGreaterEqual(stats.nCrInitial, stats.nCr)
+        self.assertGreaterEqual(stats.nSpan, stats.nCrInitial)
+        self.assertGreaterEqual(stats.nPixel, stats.nSpan)
+        self.assertGreaterEqual(stats.nCandidate, stats.nPixel)
+        self.assertLess(stats.nCandidate, self.mi.getWidth()*self.mi.getHeight())
+        self.assertGreater(len(stats.nGrow), 0)
+        self.assertLessEqual(len(stats.nGrow), crConfig.niteration)
+
+        times = [stats.detectTime, stats.mergeTime, stats.filterTime, stats.removeTime, stats.growTime]
+        for t in times:
+            self.assertGreaterEqual(t, 0.0)
+        self.assertGreaterEqual(stats.totalTime, sum(times))
+
+
+class CosmicRayReplacementTestCase(lsst.utils.tests.TestCase):
+    """Test the values that replace the pixels of a CR."""
+
+    def setUp(self):
+        self.psf = algorithms.DoubleGaussianPsf(29, 29, 2.0)
+        # A single bright pixel on a noiseless, flat sky
+        self.mi = afwImage.MaskedImageF(40, 40)
+        self.mi.getVariance().set(100.0)
+        self.x, self.y = 20, 20
+        self.mi.getImage().getArray()[self.y, self.x] = 1000.0
+        self.policy = pexConfig.makePolicy(algorithms.FindCosmicRaysConfig())
+
+    def tearDown(self):
+        del self.psf
+        del self.mi
+
+    def testLpcEstimate(self):
+        """Test that an uncontaminated 1-D estimate replaces the CR
+
+        The W-E estimate is the smallest, and the only one that's less than
+        the estimates before it, so it's used without debiasing.
+        """
+        ima = self.mi.getImage().getArray()
+        ima[self.y, self.x - 2] = 20.0
+        ima[self.y, self.x + 2] = 20.0
+
+        crs = algorithms.findCosmicRays(self.mi, self.psf, 0.0, self.policy)
+        self.assertEqual(len(crs), 1)
+        self.assertEqual(crs[0].getArea(), 1)
+        self.assertAlmostEqual(ima[self.y, self.x], -0.2737*(20.0 + 20.0), places=4)
+
+    def testInterpolatedValue(self):
+        """Test the value that replaces a CR when every 1-D estimate is contaminated
+
+        The pixel is interpolated along its row and column, ignoring the CR.
+        """
+        ima = self.mi.getImage().getArray()
+        ima += 50.0
+        badBit = self.mi.getMask().getPlaneBitMask("BAD")
+        maskArr = self.mi.getMask().getArray()
+        for dx, dy in ((2, 0), (0, 2), (2, 2), (2, -2)):
+            maskArr[self.y + dy, self.x + dx] |= badBit
+            maskArr[self.y - dy, self.x - dx] |= badBit
+
+        crs = algorithms.findCosmicRays(self.mi, self.psf, 0.0, self.policy)
+        self.assertEqual(len(crs), 1)
+        self.assertEqual(crs[0].getArea(), 1)
+        self.assertAlmostEqual(ima[self.y, self.x], 50.0, places=3)
+        crBit = self.mi.getMask().getPlaneBitMask("CR")
+        interpBit = self.mi.getMask().getPlaneBitMask("INTRP")
+        self.assertEqual(maskArr[self.y, self.x], crBit | interpBit)
+
+    def testWideTrack(self):
+        """Test that a CR more than one pixel wide isn't used to estimate its own pixels
+
+        Every 1-D estimate of a pixel in a two-pixel-wide track touches the
+        other row, so the pixels are interpolated from the sky on either side.
+        """
+        ima = self.mi.getImage().getArray()
+        ima[self.y, self.x] = 0.0
+        ima[self.y:self.y + 2, 10:30] = 1000.0
+        trackBox = (slice(self.y, self.y + 2), slice(10, 30))
+
+        crs = algorithms.findCosmicRays(self.mi, self.psf, 0.0, self.policy)
+        self.assertEqual(len(crs), 1)
+        self.assertEqual(crs[0].getArea(), 40)
+        crBit = self.mi.getMask().getPlaneBitMask("CR")
+        self.assertTrue(np.all(self.mi.getMask().getArray()[trackBox] & crBit))
+        self.assertFloatsAlmostEqual(ima[trackBox], 0.0, atol=1e-3)
+
+
+class CosmicRayTooManyTestCase(lsst.utils.tests.TestCase):
+    """Test giving up when there are more than nCrPixelMax CR pixels."""
+
+    def setUp(self):
+        self.psf = algorithms.DoubleGaussianPsf(29, 29, 2.0)
+
+        width, height = 200, 150
+        self.mi = afwImage.MaskedImageF(width, height)
+        rng = np.random.RandomState(314159)
+        self.mi.getImage().getArray()[:] = rng.normal(0.0, 10.0, (height, width))
+        self.mi.getVariance().set(100.0)
+        #
+        # Add some long CRs with faint wings, which are only found when the CRs are grown
+        #
+        ima = self.mi.getImage().getArray()
+        for y in (30, 75, 120):
+            x = rng.randint(20, width - 60)
+            ima[y, x:x + 40] += 2000.0
+            ima[y - 1, x:x + 40] += 100.0
+            ima[y + 1, x:x + 40] += 100.0
+        for i in range(50):
+            x, y = rng.randint(2, width - 2), rng.randint(2, height - 2)
+            ima[y, x] += rng.uniform(300, 3000)
+
+        self.crConfig = algorithms.FindCosmicRaysConfig()
+        self.stats = algorithms.CosmicRayStatistics()
+        algorithms.findCosmicRays(afwImage.MaskedImageF(self.mi, True), self.psf, 0.0,
+                                  pexConfig.makePolicy(self.crConfig), stats=self.stats)
+
+    def tearDown(self):
+        del self.psf
+        del self.mi
+
+    def testTooManyInitially(self):
+        """Test that giving up during the initial search leaves the image and mask unchanged"""
+        self.crConfig.nCrPixelMax = self.stats.nPixel - 1
+        mi = afwImage.MaskedImageF(self.mi, True)
+        with self.assertRaises(lsst.pex.exceptions.LengthError):
+            algorithms.findCosmicRays(mi, self.psf, 0.0, pexConfig.makePolicy(self.crConfig))
+        self.assertImagesEqual(mi.getImage(), self.mi.getImage())
+        self.assertMasksEqual(mi.getMask(), self.mi.getMask())
+
+    def testTooManyWhileGrowing(self):
+        """Test that giving up while growing the CRs leaves the mask unchanged"""
+        self.assertGreater(self.stats.nGrow[0], 0)
+        # enough for the initial CR pixels, but not for the ones added to them
+        self.crConfig.nCrPixelMax = self.stats.nPixel
+        mi = afwImage.MaskedImageF(self.mi, True)
+        with self.assertRaises(lsst.pex.exceptions.LengthError):
+            algorithms.findCosmicRays(mi, self.psf, 0.0, pexConfig.makePolicy(self.crConfig))
+        self.assertMasksEqual(mi.getMask(), self.mi.getMask())
+
+
+class CosmicRayTiledTestCase(lsst.utils.tests.TestCase):
+    """Test that searching for CRs in tiles gives the same answers as searching the whole image."""
+
+    def setUp(self):
+        self.FWHM = 5                   # pixels
+        self.psf = algorithms.DoubleGaussianPsf(29, 29, self.FWHM/(2*math.sqrt(2*math.log(2))))
+
+        width, height = 300, 201
+        self.mi = afwImage.MaskedImageF(width, height)
+        self.mi.setXY0(lsst.geom.PointI(10, 20))
+        rng = np.random.RandomState(54321)
+        self.mi.getImage().getArray()[:] = rng.normal(0.0, 10.0, (height, width))
+        self.mi.getVariance().set(100.0)
+        #
+        # Add CRs; some of them cross the boundaries between the tiles
+        #
+        ima = self.mi.getImage().getArray()
+        for x, y in ((40, 64), (97, 100), (150, 30), (201, 128), (255, 150)):
+            ima[y - 5:y + 6, x] += 1000.0
+            ima[y, x - 5:x + 6] += 500.0
+        for i in range(100):
+            x, y = rng.randint(2, width - 2), rng.randint(2, height - 2)
+            ima[y, x] += rng.uniform(300, 3000)
+
+        self.crConfig = algorithms.FindCosmicRaysConfig()
+
+    def tearDown(self):
+        del self.psf
+        del self.mi
+
+    @staticmethod
+    def sortCrs(crs):
+        """Sort CRs by their first pixel, as findCosmicRaysTiled does."""
+        def firstPixel(cr):
+            span = next(iter(cr.getSpans()))
+            return (span.getY(), span.getX0())
+
+        return sorted(crs, key=firstPixel)
+
+    def testTiled(self):
+        mi0 = afwImage.MaskedImageF(self.mi, True)
+        policy = pexConfig.makePolicy(self.crConfig)
+        crs0 = self.sortCrs(algorithms.findCosmicRays(mi0, self.psf, 0.0, policy))
+        self.assertGreater(len(crs0), 0)
+
+        for tileWidth, tileHeight in ((100, 64), (300, 50), (1000, 1000)):
+            mi = afwImage.MaskedImageF(self.mi, True)
+            crs = algorithms.findCosmicRaysTiled(mi, self.psf, 0.0, pexConfig.makePolicy(self.crConfig),
+                                                 tileWidth, tileHeight, overlap=16)
+            msg = "tile %dx%d" % (tileWidth, tileHeight)
+            self.assertEqual(len(crs), len(crs0), msg)
+            for cr, cr0 in zip(crs, crs0):
+                self.assertEqual(cr.getSpans(), cr0.getSpans(), msg)
+            self.assertMasksEqual(mi.getMask(), mi0.getMask(), msg=msg)
+
+    def testCallbacks(self):
+        """Test reading and writing the tiles with callbacks."""
+        bboxes = []
+
+        def readTile(bbox):
+            bboxes.append(bbox)
+            return afwImage.MaskedImageF(self.mi, bbox, afwImage.PARENT, True)
+
+        output = afwImage.MaskedImageF(self.mi.getBBox())
+
+        def writeTile(tile, bbox):
+            output.assign(tile[bbox], bbox)
+
+        crs = algorithms.findCosmicRaysTiled(self.mi.getBBox(), readTile, writeTile, self.psf, 0.0,
+                                             pexConfig.makePolicy(self.crConfig), 100, 100, 16)
+        self.assertEqual(len(bboxes), 6)
+        for bbox in bboxes:
+            self.assertLessEqual(bbox.getWidth(), 132)
+            self.assertLessEqual(bbox.getHeight(), 132)
+
+        mi0 = afwImage.MaskedImageF(self.mi, True)
+        policy = pexConfig.makePolicy(self.crConfig)
+        crs0 = self.sortCrs(algorithms.findCosmicRays(mi0, self.psf, 0.0, policy))
+        self.assertEqual([cr.getSpans() for cr in crs], [cr.getSpans() for cr in crs0])
+        self.assertMasksEqual(output.getMask(), mi0.getMask())
+
+    def testFaintTails(self):
+        """Test CRs whose faint tails cross into the next tile
+
+        The tails are only found as part of the bright CRs, so the tile that
+        owns them must see the original pixels of the CRs in its overlap.
+        """
+        mi = afwImage.MaskedImageF(self.mi.getBBox())
+        mi.setXY0(self.mi.getXY0())
+        rng = np.random.RandomState(8086)
+        ima = mi.getImage().getArray()
+        ima[:] = rng.normal(0.0, 10.0, ima.shape)
+        mi.getVariance().set(100.0)
+        tail = [200.0, 120.0, 80.0, 60.0]
+        # tiles of 100x100 pixels start at x = 100 and y = 100 in the image's array
+        ima[40, 85:100] += 1500.0
+        ima[40, 100:104] += tail
+        ima[85:100, 160] += 1500.0
+        ima[100:104, 160] += tail
+
+        mi0 = afwImage.MaskedImageF(mi, True)
+        policy = pexConfig.makePolicy(self.crConfig)
+        crs0 = self.sortCrs(algorithms.findCosmicRays(mi0, self.psf, 0.0, policy))
+        crBit = mi0.getMask().getPlaneBitMask("CR")
+        self.assertTrue(mi0.getMask().getArray()[40, 100] & crBit)
+        self.assertTrue(mi0.getMask().getArray()[100, 160] & crBit)
+
+        crs = algorithms.findCosmicRaysTiled(mi, self.psf, 0.0, policy, 100, 100, overlap=16)
+        self.assertEqual([cr.getSpans() for cr in crs], [cr.getSpans() for cr in crs0])
+        self.assertMasksEqual(mi.getMask(), mi0.getMask())
+
+
+class CosmicRayBatchTestCase(lsst.utils.tests.TestCase):
+    """Test that searching a batch of images gives the same answers as searching them one by one."""
+
+    def setUp(self):
+        psf1 = algorithms.DoubleGaussianPsf(29, 29, 2.0)
+        psf2 = algorithms.DoubleGaussianPsf(29, 29, 3.0)
+        self.psfs = [psf1, psf2, psf1, psf2, psf1]
+
+        rng = np.random.RandomState(666)
+        self.images = []
+        for i in range(len(self.psfs)):
+            mi = afwImage.MaskedImageF(120, 100)
+            ima = mi.getImage().getArray()
+            ima[:] = rng.normal(0.0, 10.0, ima.shape)
+            mi.getVariance().set(100.0)
+            for j in range(20):
+                x, y = rng.randint(2, 118), rng.randint(2, 98)
+                ima[y, x] += rng.uniform(300, 3000)
+            self.images.append(mi)
+
+        self.bkgds = [0.0, 1.0, 2.0, 3.0, 4.0]
+
+    def tearDown(self):
+        del self.psfs
+        del self.images
+
+    def testBatch(self):
+        policy = pexConfig.makePolicy(algorithms.FindCosmicRaysConfig())
+
+        expected = []
+        for mi, psf, bkgd in zip(self.images, self.psfs, self.bkgds):
+            mi = afwImage.MaskedImageF(mi, True)
+            expected.append((mi, algorithms.findCosmicRays(mi, psf, bkgd, policy, True)))
+
+        for nThreads in (1, 3):
+            images = [afwImage.MaskedImageF(mi, True) for mi in self.images]
+            results = algorithms.findCosmicRaysBatch(images, self.psfs, self.bkgds, policy, nThreads, True)
+            self.assertEqual(len(results), len(images))
+            for mi, crs, (mi0, crs0) in zip(images, results, expected):
+                self.assertGreater(len(crs0), 0)
+                self.assertEqual([cr.getSpans() for cr in crs], [cr.getSpans() for cr in crs0])
+                self.assertMaskedImagesEqual(mi, mi0)
+
+    def testBadLengths(self):
+        policy = pexConfig.makePolicy(algorithms.FindCosmicRaysConfig())
+        with self.assertRaises(lsst.pex.exceptions.LengthError):
+            algorithms.findCosmicRaysBatch(self.images, self.psfs[:-1], self.bkgds, policy)
+
+
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass
 
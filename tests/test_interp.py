@@ -28,6 +28,7 @@ import lsst.geom
 import lsst.afw.image as afwImage
 import lsst.meas.algorithms as algorithms
 import lsst.meas.algorithms.defects as defects
+import lsst.pex.exceptions
 import lsst.utils.tests
 
 try:
@@ -234,6 +235,314 @@ class InterpolationTestCase(lsst.utils.tests.TestCase):
             self.assertGreater(2, np.max(ima))
 
 
+class DefectPlanTestCase(lsst.utils.tests.TestCase):
+    """A test case for DefectPlan."""
+
+    def setUp(self):
+        self.psf = algorithms.DoubleGaussianPsf(15, 15, 1./(2*math.sqrt(2*math.log(2))))
+        self.bbox = lsst.geom.BoxI(lsst.geom.PointI(10, 20), lsst.geom.ExtentI(80, 60))
+        self.mi = afwImage.MaskedImageF(self.bbox)
+        rand = np.random.RandomState(666)
+        self.mi.image.array[:] = rand.uniform(-1, 1, self.mi.image.array.shape)
+        self.mi.variance.array[:] = 1.0
+        #
+        # A selection of defects at the edges, near the edges, touching each other and wide
+        #
+        self.defectList = []
+        for x0, y0, width, height in [(10, 20, 3, 60),     # left edge
+                                      (14, 30, 2, 20),     # near left edge
+                                      (86, 20, 4, 30),     # right edge
+                                      (30, 25, 1, 50),     # middle
+                                      (31, 40, 2, 5),      # touching the previous
+                                      (34, 40, 1, 5),      # one good pixel from the previous
+                                      (40, 60, 20, 3),     # wide
+                                      (85, 70, 20, 20)]:   # overlapping right edge and top
+            bbox = lsst.geom.BoxI(lsst.geom.PointI(x0, y0), lsst.geom.ExtentI(width, height))
+            self.defectList.append(algorithms.Defect(bbox))
+
+    def tearDown(self):
+        del self.mi
+        del self.psf
+        del self.defectList
+
+    def testApply(self):
+        """Test that applying a plan is the same as calling interpolateOverDefects"""
+        plan = algorithms.DefectPlan(self.defectList, self.bbox)
+        self.assertEqual(plan.getBBox(), self.bbox)
+        self.assertGreater(plan.getNumRuns(), 0)
+        self.assertEqual(sum(len(plan.getRuns(y)) for y in range(self.bbox.getHeight())),
+                         plan.getNumRuns())
+
+        runs = plan.getRuns(40 - self.bbox.getMinY())
+        self.assertEqual([(run.x0, run.x1) for run in runs], [(0, 2), (4, 5), (20, 22), (24, 24), (76, 79)])
+        self.assertEqual(runs[0].pos, algorithms.Defect.LEFT)
+        self.assertEqual(runs[-1].pos, algorithms.Defect.RIGHT)
+
+        expected = afwImage.MaskedImageF(self.mi, True)
+        algorithms.interpolateOverDefects(expected, self.psf, self.defectList, 0, True)
+
+        for i in range(2):              # a plan may be applied more than once
+            mi = afwImage.MaskedImageF(self.mi, True)
+            plan.apply(mi, 0, True)
+            self.assertMaskedImagesEqual(mi, expected)
+
+    def testThreads(self):
+        """Test that the result doesn't depend on the number of threads"""
+        # make the image tall enough that every thread gets some rows
+        bbox = lsst.geom.BoxI(self.bbox.getMin(), lsst.geom.ExtentI(self.bbox.getWidth(), 1000))
+        mi0 = afwImage.MaskedImageF(bbox)
+        rand = np.random.RandomState(666)
+        mi0.image.array[:] = rand.uniform(-1, 1, mi0.image.array.shape)
+
+        expected = afwImage.MaskedImageF(mi0, True)
+        algorithms.interpolateOverDefects(expected, self.psf, self.defectList, 0, True)
+
+        plan = algorithms.DefectPlan(self.defectList, bbox)
+        for nThreads in (1, 2, 4, 0):
+            mi = afwImage.MaskedImageF(mi0, True)
+            algorithms.interpolateOverDefects(mi, self.psf, self.defectList, 0, True, nThreads=nThreads)
+            self.assertMaskedImagesEqual(mi, expected)
+
+            mi = afwImage.MaskedImageF(mi0, True)
+            plan.apply(mi, 0, True, nThreads=nThreads)
+            self.assertMaskedImagesEqual(mi, expected)
+
+    def testBatch(self):
+        """Test applying a plan to a set of images"""
+        # a defect covering an entire row will be set to the fallback value
+        fullRow = lsst.geom.BoxI(lsst.geom.PointI(self.bbox.getMinX(), self.bbox.getMinY() + 5),
+                                 lsst.geom.ExtentI(self.bbox.getWidth(), 1))
+        plan = algorithms.DefectPlan(self.defectList + [algorithms.Defect(fullRow)], self.bbox)
+        nPixel = sum(run.x1 - run.x0 + 1 for y in range(self.bbox.getHeight()) for run in plan.getRuns(y))
+
+        rand = np.random.RandomState(666)
+        images = []
+        for i in range(3):
+            mi = afwImage.MaskedImageF(self.bbox)
+            mi.image.array[:] = rand.uniform(-1, 1, mi.image.array.shape)
+            images.append(mi)
+        images[1].image.array[10, 19] = np.nan  # next to the bad column at x == 20
+        expected = [afwImage.MaskedImageF(mi, True) for mi in images]
+        expectedStats = [plan.apply(mi, 10, True) for mi in expected]
+        for i, stats in enumerate(expectedStats):
+            self.assertEqual(stats.nPixel, nPixel)
+            self.assertEqual(stats.nFallback, self.bbox.getWidth())
+            if i == 1:
+                self.assertGreater(stats.nNonFinite, 0)
+            else:
+                self.assertEqual(stats.nNonFinite, 0)
+
+        for nThreads in (1, 4):
+            imagesBatch = [afwImage.MaskedImageF(mi, True) for mi in images]
+            statsBatch = plan.applyBatch(imagesBatch, 10, True, nThreads=nThreads)
+            self.assertEqual(len(statsBatch), len(images))
+
+            for mi, stats, mi0, stats0 in zip(imagesBatch, statsBatch, expected, expectedStats):
+                self.assertMaskedImagesEqual(mi, mi0)
+                self.assertEqual((stats.nPixel, stats.nFallback, stats.nNonFinite),
+                                 (stats0.nPixel, stats0.nFallback, stats0.nNonFinite))
+
+        self.assertEqual(plan.applyBatch([]), [])
+
+    def testColumns(self):
+        """Test interpolating tall defects along columns"""
+        plan = algorithms.DefectPlan(self.defectList, self.bbox, columnAspectRatio=5)
+        self.assertEqual(plan.getColumns(), [0, 1, 2, 4, 5, 20, 24, 76, 77, 78, 79])
+        self.assertEqual([(run.x0, run.x1) for run in plan.getColumnRuns(20)], [(5, 54)])
+        self.assertEqual(plan.getColumnRuns(21), [])
+        self.assertEqual([(run.x0, run.x1) for run in plan.getRuns(40 - self.bbox.getMinY())], [(21, 22)])
+        with self.assertRaises(lsst.pex.exceptions.OutOfRangeError):
+            plan.getColumnRuns(self.bbox.getWidth())
+        #
+        # Every bad pixel is interpolated exactly once, by one pass or the other
+        #
+        rowPlan = algorithms.DefectPlan(self.defectList, self.bbox)
+        self.assertEqual(rowPlan.getColumns(), [])
+        mi, expected = afwImage.MaskedImageF(self.mi, True), afwImage.MaskedImageF(self.mi, True)
+        stats = plan.apply(mi, 0, True)
+        expectedStats = rowPlan.apply(expected, 0, True)
+        self.assertEqual(stats.nPixel, expectedStats.nPixel)
+        self.assertImagesEqual(mi.mask, expected.mask)
+        bad = (mi.mask.array & mi.mask.getPlaneBitMask("INTRP")) != 0
+        self.assertFloatsEqual(mi.image.array[~bad], self.mi.image.array[~bad])
+
+        for nThreads in (1, 4):
+            images = [afwImage.MaskedImageF(self.mi, True) for i in range(2)]
+            plan.applyBatch(images, 0, True, nThreads=nThreads)
+            for mi2 in images:
+                self.assertMaskedImagesEqual(mi2, mi)
+        #
+        # A bad column in an image whose columns differ a lot from each other, but which is smooth
+        # along each column, is much better interpolated along the column
+        #
+        mi0 = afwImage.MaskedImageF(self.bbox)
+        y, x = np.mgrid[0:mi0.getHeight(), 0:mi0.getWidth()]
+        mi0.image.array[:] = np.random.RandomState(666).uniform(0, 100, mi0.getWidth())[x] + 0.01*y
+        badColumn = [algorithms.Defect(lsst.geom.BoxI(lsst.geom.PointI(60, 40), lsst.geom.ExtentI(1, 10)))]
+        truth = mi0.image.array[20:30, 50]
+
+        mi = afwImage.MaskedImageF(mi0, True)
+        algorithms.interpolateOverDefects(mi, self.psf, badColumn, columnAspectRatio=5)
+        self.assertFloatsAlmostEqual(mi.image.array[20:30, 50], truth, atol=0.2)
+
+        mi = afwImage.MaskedImageF(mi0, True)
+        algorithms.interpolateOverDefects(mi, self.psf, badColumn)
+        self.assertGreater(np.max(np.abs(mi.image.array[20:30, 50] - truth)), 1)
+
+    def testMask(self):
+        """Test interpolating over the pixels identified by a mask"""
+        mi = afwImage.MaskedImageF(self.mi, True)
+        bad = mi.mask.getPlaneBitMask("BAD")
+        x0, y0 = self.bbox.getMin()
+        for defect in self.defectList:
+            bbox = defect.getBBox()
+            mi.mask.array[bbox.getMinY() - y0:bbox.getMaxY() + 1 - y0,
+                          bbox.getMinX() - x0:bbox.getMaxX() + 1 - x0] |= bad
+        nBad = np.sum((mi.mask.array & bad) != 0)
+        #
+        # The plan is the same as if we'd used the Defects, including the choice of columns to
+        # interpolate vertically
+        #
+        for columnAspectRatio in (0, 5):
+            plan = algorithms.DefectPlan(mi.mask, bad, columnAspectRatio)
+            expected = algorithms.DefectPlan(self.defectList, self.bbox, columnAspectRatio)
+            self.assertEqual(plan.getBBox(), self.bbox)
+            self.assertEqual(plan.getColumns(), expected.getColumns())
+            for y in range(self.bbox.getHeight()):
+                self.assertEqual([(r.x0, r.x1, r.pos, r.type) for r in plan.getRuns(y)],
+                                 [(r.x0, r.x1, r.pos, r.type) for r in expected.getRuns(y)])
+            for x in plan.getColumns():
+                self.assertEqual([(r.x0, r.x1, r.pos, r.type) for r in plan.getColumnRuns(x)],
+                                 [(r.x0, r.x1, r.pos, r.type) for r in expected.getColumnRuns(x)])
+
+        expected = afwImage.MaskedImageF(mi, True)
+        algorithms.interpolateOverDefects(expected, self.psf, self.defectList, 0, True)
+        stats = algorithms.interpolateOverMask(mi, bad, 0, True)
+        self.assertMaskedImagesEqual(mi, expected)
+        self.assertEqual(stats.nPixel, nBad)
+        # only pixels with bits in the bitmask are interpolated
+        self.assertEqual(algorithms.DefectPlan(mi.mask, mi.mask.getPlaneBitMask("SAT")).getNumRuns(), 0)
+
+    def testBadBBox(self):
+        """Test that we can't apply a plan to an image with a different bounding box"""
+        plan = algorithms.DefectPlan(self.defectList, self.bbox)
+        mi = afwImage.MaskedImageF(self.bbox.getDimensions())
+        with self.assertRaises(lsst.pex.exceptions.LengthError):
+            plan.apply(mi)
+
+    def testPersistence(self):
+        """Test that a plan can be written and read back"""
+        for columnAspectRatio in (0, 5):
+            plan = algorithms.DefectPlan(self.defectList, self.bbox, columnAspectRatio)
+            with lsst.utils.tests.getTempFilePath(".fits") as filename:
+                plan.writeFits(filename)
+                plan2 = algorithms.DefectPlan.readFits(filename)
+
+            self.assertEqual(plan2.getBBox(), plan.getBBox())
+            self.assertEqual(plan2.getNumRuns(), plan.getNumRuns())
+            for y in range(self.bbox.getHeight()):
+                self.assertEqual([(r.x0, r.x1, r.pos, r.type) for r in plan2.getRuns(y)],
+                                 [(r.x0, r.x1, r.pos, r.type) for r in plan.getRuns(y)])
+            self.assertEqual(plan2.getColumns(), plan.getColumns())
+            for x in plan.getColumns():
+                self.assertEqual([(r.x0, r.x1, r.pos, r.type) for r in plan2.getColumnRuns(x)],
+                                 [(r.x0, r.x1, r.pos, r.type) for r in plan.getColumnRuns(x)])
+
+            mi, mi2 = afwImage.MaskedImageF(self.mi, True), afwImage.MaskedImageF(self.mi, True)
+            plan.apply(mi)
+            plan2.apply(mi2)
+            self.assertMaskedImagesEqual(mi2, mi)
+
+    def testDefectFile(self):
+        """Test that defects can be written to a FITS table and read back"""
+        with lsst.utils.tests.getTempFilePath(".fits") as filename:
+            algorithms.writeDefects(filename, self.defectList)
+            defectList = algorithms.readDefects(filename)
+        self.assertEqual([d.getBBox() for d in defectList], [d.getBBox() for d in self.defectList])
+
+        with lsst.utils.tests.getTempFilePath(".fits") as filename:
+            algorithms.writeDefects(filename, [])
+            self.assertEqual(algorithms.readDefects(filename), [])
+
+        # Convert a policy file
+        policyFile = os.path.join(lsst.utils.getPackageDir('meas_algorithms'), "policy", "BadPixels.paf")
+        badPixels = defects.policyToBadRegionList(policyFile)
+        with lsst.utils.tests.getTempFilePath(".fits") as filename:
+            self.assertEqual(defects.policyToDefectFile(policyFile, filename), len(badPixels))
+            defectList = algorithms.readDefects(filename)
+        self.assertEqual([d.getBBox() for d in defectList], [d.getBBox() for d in badPixels])
+
+
+class SinglePixelTestCase(lsst.utils.tests.TestCase):
+    """A test case for interp.singlePixel."""
+
+    def setUp(self):
+        self.mi = afwImage.MaskedImageF(lsst.geom.BoxI(lsst.geom.PointI(100, 200), lsst.geom.ExtentI(50, 60)))
+        # a plane, which the LPC interpolants reproduce
+        y, x = np.mgrid[0:self.mi.getHeight(), 0:self.mi.getWidth()]
+        self.mi.image.array[:] = 100 + 2*x + 3*y
+        self.badBit = self.mi.mask.getPlaneBitMask("BAD")
+
+    def tearDown(self):
+        del self.mi
+
+    def testSinglePixel(self):
+        """Test interpolating over a single bad pixel"""
+        x, y = 120, 230                 # parent coordinates
+        expected = self.mi.image[x, y, afwImage.PARENT]
+        self.mi.image[x, y, afwImage.PARENT] = 1e4
+
+        for horizontal in (True, False):
+            ok, value = algorithms.singlePixel(x, y, self.mi, horizontal, 0.0)
+            self.assertTrue(ok)
+            self.assertAlmostEqual(value, expected, delta=1e-3*expected)
+
+    def testRun(self):
+        """Test interpolating over a pixel in a run of bad pixels"""
+        x, y = 120, 230
+        ix, iy = x - self.mi.getX0(), y - self.mi.getY0()
+        expected = self.mi.image.array[iy, ix]
+        self.mi.image.array[iy, ix - 2:ix + 3] = 1e4
+        self.mi.mask.array[iy, ix - 2:ix + 3] |= self.badBit
+
+        ok, value = algorithms.singlePixel(x, y, self.mi, True, 0.0, self.badBit)
+        self.assertTrue(ok)
+        self.assertAlmostEqual(value, expected, delta=1e-2*expected)
+        # without the mask the neighbouring bad pixels are used
+        ok, value = algorithms.singlePixel(x, y, self.mi, True, 0.0)
+        self.assertTrue(ok)
+        self.assertGreater(value, 5e3)
+        # the run only affects the horizontal interpolation
+        ok, value = algorithms.singlePixel(x, y, self.mi, False, 0.0, self.badBit)
+        self.assertTrue(ok)
+        self.assertAlmostEqual(value, expected, delta=1e-3*expected)
+
+    def testFailures(self):
+        """Test that we report failure when we can't interpolate"""
+        x0, y0 = self.mi.getX0(), self.mi.getY0()
+        self.assertFalse(algorithms.singlePixel(x0 + 1, y0 + 10, self.mi, True, 0.0)[0])  # too near the edge
+        self.assertTrue(algorithms.singlePixel(x0 + 2, y0 + 10, self.mi, True, 0.0)[0])
+        self.assertFalse(algorithms.singlePixel(x0 + 10, y0 + 1, self.mi, False, 0.0)[0])
+        self.assertTrue(algorithms.singlePixel(x0 + 10, y0 + 2, self.mi, False, 0.0)[0])
+        self.assertFalse(algorithms.singlePixel(x0 - 1, y0 + 10, self.mi, True, 0.0)[0])  # off the image
+
+        self.mi.mask.array[10, 5:45] |= self.badBit  # too long a run
+        self.assertFalse(algorithms.singlePixel(x0 + 20, y0 + 10, self.mi, True, 0.0, self.badBit)[0])
+        self.assertTrue(algorithms.singlePixel(x0 + 20, y0 + 10, self.mi, False, 0.0, self.badBit)[0])
+
+    def testSinglePixels(self):
+        """Test that singlePixels is equivalent to calling singlePixel repeatedly"""
+        self.mi.mask.array[20, 10:14] |= self.badBit
+        positions = [lsst.geom.PointI(self.mi.getX0() + x, self.mi.getY0() + y)
+                     for x, y in [(1, 1), (5, 5), (11, 20), (25, 30), (48, 58)]]
+        for horizontal in (True, False):
+            values = algorithms.singlePixels(positions, self.mi, horizontal, 0.0, self.badBit)
+            self.assertEqual(len(values), len(positions))
+            for pos, value in zip(positions, values):
+                self.assertEqual(value, algorithms.singlePixel(pos.getX(), pos.getY(), self.mi,
+                                                               horizontal, 0.0, self.badBit))
+
+
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass
 